@@ -0,0 +1,73 @@
+#ifndef SPOOK64_HOST_LIBDRAGON
+#define SPOOK64_HOST_LIBDRAGON
+
+// Just enough of libdragon to build the simulation on the host with make host.
+// Only what state.c, path.c, levels.c and the headers they pull in use.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// No stdlib.h, rand.h declares its own rand.
+
+#define assertf(expr, ...) do { \
+	if (!(expr)) { \
+		fprintf(stderr, "%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #expr); \
+		fprintf(stderr, __VA_ARGS__); \
+		fprintf(stderr, "\n"); \
+		__builtin_abort(); \
+	} \
+} while (0)
+
+#define debugf(...) fprintf(stderr, __VA_ARGS__)
+
+// Same rate as the N64's COP0 count, so tick based constants mean the same thing.
+#define TICKS_PER_SECOND (93750000/2)
+#define TICKS_TO_US(t) ((uint64_t)(t) * 1000000ULL / TICKS_PER_SECOND)
+#define TICKS_READ() ((uint32_t)timer_ticks())
+long long timer_ticks(void);
+
+// Only ever passed around by pointer on the simulation side.
+typedef struct {
+	uint16_t width;
+	uint16_t height;
+	uint16_t stride;
+	uint16_t flags;
+	void *buffer;
+} surface_t;
+
+typedef struct sprite_s sprite_t;
+
+typedef struct {
+	unsigned A : 1;
+	unsigned B : 1;
+	unsigned Z : 1;
+	unsigned start : 1;
+	unsigned up : 1;
+	unsigned down : 1;
+	unsigned left : 1;
+	unsigned right : 1;
+	unsigned L : 1;
+	unsigned R : 1;
+	unsigned C_up : 1;
+	unsigned C_down : 1;
+	unsigned C_left : 1;
+	unsigned C_right : 1;
+	signed x : 8;
+	signed y : 8;
+} SI_condat;
+
+struct controller_data {
+	SI_condat c[4];
+};
+
+// Input comes from host_input_set, see host/main.c.
+void controller_scan(void);
+struct controller_data get_keys_held(void);
+struct controller_data get_keys_down(void);
+
+void host_input_set(const SI_condat *pad);
+
+#endif
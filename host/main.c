@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include "dragon.h"
+#include "state.h"
+
+// Runs state_update on the host from scripted input and reports how long it took.
+//
+//   spook64-host [-f frames] [script]
+//
+// Each script line is "<frames> <buttons> <stick x> <stick y>", buttons are
+// joined with '+' or '-' for none, e.g. "30 Z+A 0 80". Lines starting with '#'
+// are comments. The script loops until the frame count is reached, by default
+// it runs once. Without a script the pad is left idle.
+
+#define MAX_SCRIPT_STEPS 1024
+
+typedef struct {
+	uint32_t frames;
+	SI_condat pad;
+} input_step_t;
+
+static input_step_t steps[MAX_SCRIPT_STEPS];
+static int step_count;
+
+static bool parse_buttons(SI_condat *pad, char *buttons) {
+	if (strcmp(buttons, "-") == 0) return true;
+
+	for (char *name = strtok(buttons, "+"); name != NULL; name = strtok(NULL, "+")) {
+		if (strcmp(name, "A") == 0) pad->A = 1;
+		else if (strcmp(name, "B") == 0) pad->B = 1;
+		else if (strcmp(name, "Z") == 0) pad->Z = 1;
+		else if (strcmp(name, "start") == 0) pad->start = 1;
+		else if (strcmp(name, "up") == 0) pad->up = 1;
+		else if (strcmp(name, "down") == 0) pad->down = 1;
+		else if (strcmp(name, "left") == 0) pad->left = 1;
+		else if (strcmp(name, "right") == 0) pad->right = 1;
+		else if (strcmp(name, "L") == 0) pad->L = 1;
+		else if (strcmp(name, "R") == 0) pad->R = 1;
+		else if (strcmp(name, "C_up") == 0) pad->C_up = 1;
+		else if (strcmp(name, "C_down") == 0) pad->C_down = 1;
+		else if (strcmp(name, "C_left") == 0) pad->C_left = 1;
+		else if (strcmp(name, "C_right") == 0) pad->C_right = 1;
+		else return false;
+	}
+	return true;
+}
+
+static void usage(FILE *out) {
+	fprintf(out, "usage: spook64-host [-f frames] [script]\n");
+}
+
+// Returns false after printing what's wrong with the script.
+static bool load_script(const char *path) {
+	FILE *file = fopen(path, "r");
+	if (file == NULL) {
+		fprintf(stderr, "Can't open %s.\n", path);
+		return false;
+	}
+
+	char line[256];
+	int line_number = 0;
+	const char *error = NULL;
+	while (error == NULL && fgets(line, sizeof(line), file) != NULL) {
+		line_number++;
+		if (line[0] == '#' || line[0] == '\n') continue;
+
+		if (step_count == MAX_SCRIPT_STEPS) {
+			error = "too many script steps";
+			break;
+		}
+		input_step_t *step = &steps[step_count];
+		memset(step, 0, sizeof(*step));
+
+		unsigned frames;
+		char buttons[128];
+		int x, y;
+		int fields = sscanf(line, "%u %127s %d %d", &frames, buttons, &x, &y);
+		if (fields != 4) {
+			error = "expected <frames> <buttons> <x> <y>";
+		} else if (frames == 0) {
+			error = "a step needs at least one frame";
+		} else if (!parse_buttons(&step->pad, buttons)) {
+			error = "unknown button";
+		} else if (x < -128 || x > 127 || y < -128 || y > 127) {
+			error = "stick out of range";
+		} else {
+			step->frames = frames;
+			step->pad.x = x;
+			step->pad.y = y;
+			step_count++;
+		}
+	}
+	fclose(file);
+
+	if (error != NULL) {
+		fprintf(stderr, "%s:%d: %s.\n", path, line_number, error);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv) {
+	uint32_t frame_limit = 0;
+	const char *script_path = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+			usage(stdout);
+			return 0;
+		} else if (strcmp(argv[i], "-f") == 0) {
+			char *end = NULL;
+			if (i + 1 < argc) frame_limit = strtoul(argv[++i], &end, 10);
+			if (end == NULL || *end != '\0' || frame_limit == 0) {
+				fprintf(stderr, "-f needs a frame count above 0.\n");
+				usage(stderr);
+				return 2;
+			}
+		} else if (argv[i][0] == '-' || script_path != NULL) {
+			fprintf(stderr, "Unexpected argument %s.\n", argv[i]);
+			usage(stderr);
+			return 2;
+		} else {
+			script_path = argv[i];
+		}
+	}
+
+	uint32_t script_frames = 0;
+	if (script_path != NULL) {
+		if (!load_script(script_path)) return 1;
+		for (int i = 0; i < step_count; i++) {
+			script_frames += steps[i].frames;
+		}
+	}
+	if (frame_limit == 0) frame_limit = script_frames;
+	if (frame_limit == 0) {
+		fprintf(stderr, "Nothing to run, pass a script or -f frames.\n");
+		usage(stderr);
+		return 2;
+	}
+
+	state_init();
+
+	uint64_t total_ticks = 0;
+	uint32_t min_ticks = UINT32_MAX;
+	uint32_t max_ticks = 0;
+
+	uint32_t frame = 0;
+	int step = 0;
+	uint32_t step_frame = 0;
+	SI_condat idle;
+	memset(&idle, 0, sizeof(idle));
+	while (frame < frame_limit && game_state.status != GAME_STATUS_BEAT) {
+		if (script_frames > 0) {
+			while (step_frame >= steps[step].frames) {
+				step = (step + 1) % step_count;
+				step_frame = 0;
+			}
+			host_input_set(&steps[step].pad);
+			step_frame++;
+		} else {
+			host_input_set(&idle);
+		}
+
+		uint32_t start = TICKS_READ();
+		state_update();
+		uint32_t ticks = TICKS_READ() - start;
+
+		total_ticks += ticks;
+		if (ticks < min_ticks) min_ticks = ticks;
+		if (ticks > max_ticks) max_ticks = ticks;
+		frame++;
+	}
+
+	printf("%u frames, level %u, score %d, %d snoopers\n",
+		frame, game_state.level_index, game_state.score, game_state.snoopers.count);
+	printf("state_update us min/avg/max: %.2f %.2f %.2f\n",
+		TICKS_TO_US(min_ticks * 1000ULL) / 1000.0,
+		TICKS_TO_US(total_ticks * 1000ULL / frame) / 1000.0,
+		TICKS_TO_US(max_ticks * 1000ULL) / 1000.0);
+
+	return 0;
+}
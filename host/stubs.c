@@ -0,0 +1,81 @@
+#include <time.h>
+#include "dragon.h"
+#include "render.h"
+#include "sfx.h"
+#include "profile.h"
+
+// Host versions of everything the simulation calls outside of itself.
+// Rendering, audio and profiling do nothing, input comes from host_input_set.
+
+static SI_condat pad_held;
+static SI_condat pad_last;
+static SI_condat pad_next;
+
+long long timer_ticks(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * TICKS_PER_SECOND + (long long)now.tv_nsec * TICKS_PER_SECOND / 1000000000LL;
+}
+
+void host_input_set(const SI_condat *pad) {
+	pad_next = *pad;
+}
+
+void controller_scan(void) {
+	pad_last = pad_held;
+	pad_held = pad_next;
+}
+
+struct controller_data get_keys_held(void) {
+	struct controller_data data;
+	memset(&data, 0, sizeof(data));
+	data.c[0] = pad_held;
+	return data;
+}
+
+struct controller_data get_keys_down(void) {
+	struct controller_data data;
+	memset(&data, 0, sizeof(data));
+	data.c[0].A = pad_held.A && !pad_last.A;
+	data.c[0].B = pad_held.B && !pad_last.B;
+	data.c[0].Z = pad_held.Z && !pad_last.Z;
+	data.c[0].start = pad_held.start && !pad_last.start;
+	data.c[0].up = pad_held.up && !pad_last.up;
+	data.c[0].down = pad_held.down && !pad_last.down;
+	data.c[0].left = pad_held.left && !pad_last.left;
+	data.c[0].right = pad_held.right && !pad_last.right;
+	data.c[0].L = pad_held.L && !pad_last.L;
+	data.c[0].R = pad_held.R && !pad_last.R;
+	data.c[0].C_up = pad_held.C_up && !pad_last.C_up;
+	data.c[0].C_down = pad_held.C_down && !pad_last.C_down;
+	data.c[0].C_left = pad_held.C_left && !pad_last.C_left;
+	data.c[0].C_right = pad_held.C_right && !pad_last.C_right;
+	return data;
+}
+
+void render_load_level(const level_t *level, arena_t *arena) {}
+size_t render_level_arena_size(const level_t *level) { return 0; }
+void render_toggle_painter_mode() {}
+void render_toggle_dynamic_resolution() {}
+
+void profile_toggle() {}
+bool profile_enabled() { return false; }
+
+void sfx_init() {}
+void sfx_snooper_scream() {}
+void sfx_snooper_speak() {}
+void sfx_snooper_die() {}
+void sfx_spooker_spook() {}
+void sfx_spooker_spook_muffled() {}
+void sfx_spooker_oof() {}
+void sfx_point() {}
+void sfx_bad() {}
+void sfx_start_music() {}
+void sfx_start_menu_music() {}
+void sfx_start_win_music() {}
+void sfx_stop_music() {}
+void sfx_set_music_volume(float volume) {}
+void sfx_win() {}
+void sfx_lose() {}
+void sfx_level_start() {}
+void audio_update() {}
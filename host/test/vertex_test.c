@@ -0,0 +1,222 @@
+#include <math.h>
+#include <time.h>
+#include "dragon.h"
+#include "vertex.h"
+#include "_generated_models.h"
+
+// Checks the vertex stages in src/vertex.c against a plain reference version of the same math:
+// rotate, translate, camera, then divide, one step at a time like the renderer used to.
+// The fixed point stages are checked against the float ones, and both are timed.
+// Every generated model and lod is drawn at a spread of positions and rotations in view
+// of the game's camera, animated models at a few points of their animation.
+//
+//   make host-test
+//
+// The timings are for the host, they only say which way the VR4300 might go.
+
+// Screen space error allowed in pixels, and in shading.
+#define MAX_SCREEN_ERROR 0.01f
+#define MAX_COLOR_ERROR 0.0001f
+#define MAX_FIXED_SCREEN_ERROR 0.1f
+#define MAX_FIXED_COLOR_ERROR 0.001f
+
+#define TRANSFORM_COUNT 256
+#define TIMING_DRAWS 20000
+#define MAX_POSITIONS 256
+
+static const float animation_progress[] = {0.f, 0.3f, 0.55f, 0.975f};
+
+static float out_positions[4*MAX_POSITIONS];
+static float out_colors[3*MAX_POSITIONS];
+static float fixed_out_positions[4*MAX_POSITIONS];
+static float fixed_out_colors[3*MAX_POSITIONS];
+
+// Same as set_camera_pitch(0.8f) and update_framebuffer_size at 320x240 in render.c.
+static void camera_init(vertex_camera_t *camera) {
+	const float camera_z_factor = -0.04f;
+	const float camera_w_factor_base = 0.16f;
+	float sp = sinf(0.8f);
+	float cp = cosf(0.8f);
+
+	camera->xx = 100.f;
+	camera->yy = 100.f * cp;
+	camera->yz = 100.f * sp;
+	camera->zy = -camera_z_factor * sp;
+	camera->zz = camera_z_factor * cp;
+
+	camera->half_width = 160.f;
+	camera->half_height = 120.f;
+	camera->wx_factor = camera->half_width/160.f * camera_w_factor_base;
+	camera->wy_factor = camera->half_height/120.f * camera_w_factor_base;
+
+	camera->light_direction = (vector3_t){-0.57735f, -0.57735f, 0.57735f};
+	camera->directional_r = 0.85f;
+	camera->directional_g = 0.65f;
+	camera->directional_b = 0.45f;
+	camera->ambient_r = 0.15f;
+	camera->ambient_g = 0.25f;
+	camera->ambient_b = 0.35f;
+}
+
+static void reference_project(const vertex_camera_t *camera, const vector3_t *relative, float sin_yaw, float cos_yaw, const float *in, float *out) {
+	float x1 = cos_yaw*in[0] + sin_yaw*in[1] + relative->x;
+	float y1 = cos_yaw*in[1] - sin_yaw*in[0] + relative->y;
+	float z1 = in[2] + relative->z;
+
+	float x2 = camera->xx*x1;
+	float y2 = camera->yy*y1 + camera->yz*z1;
+	float z2 = camera->zy*y1 + camera->zz*z1;
+
+	float inv_w = 1.f / z2;
+	out[0] = camera->half_width + x2 * camera->wx_factor * inv_w;
+	out[1] = camera->half_height - y2 * camera->wy_factor * inv_w;
+	out[2] = z2;
+	out[3] = inv_w;
+}
+
+static void reference_shade(const vertex_camera_t *camera, float sin_yaw, float cos_yaw, const float *in, float *out) {
+	const vector3_t *light = &camera->light_direction;
+	float light_x = light->x * cos_yaw - light->y * sin_yaw;
+	float light_y = light->x * sin_yaw + light->y * cos_yaw;
+	float brightness = light_x*in[0] + light_y*in[1] + light->z*in[2];
+	if (brightness < 0.f) brightness = 0.f;
+
+	out[0] = camera->ambient_r + brightness * camera->directional_r;
+	out[1] = camera->ambient_g + brightness * camera->directional_g;
+	out[2] = camera->ambient_b + brightness * camera->directional_b;
+}
+
+static uint32_t random_state = 1;
+
+// 0 to 1.
+static float random_float() {
+	random_state = random_state*1664525u + 1013904223u;
+	return (random_state >> 8) * (1.f / (1 << 24));
+}
+
+typedef struct {
+	float screen;
+	float depth;
+	float color;
+} model_error_t;
+
+static float relative_error(float a, float b) {
+	return fabsf(a - b) / fabsf(b);
+}
+
+static void check_model(const vertex_camera_t *camera, const model_t *model, model_error_t *error, model_error_t *fixed_error) {
+	for (int i = 0; i < TRANSFORM_COUNT; i++) {
+		// Anywhere the renderer would draw, see VISIBLE_MIN_Y and VISIBLE_MAX_Y in render.c.
+		vector3_t relative = {
+			-10.f + 20.f*random_float(),
+			4.f + 20.f*random_float(),
+			-12.f + 2.f*random_float(),
+		};
+		float yaw = 2.f*(float)M_PI*random_float();
+		float sin_yaw = sinf(yaw);
+		float cos_yaw = cosf(yaw);
+
+		object_setup_t setup;
+		vertex_setup_object(&setup, camera, &relative, sin_yaw, cos_yaw);
+		vertex_project_float(&setup, camera, model, out_positions);
+		vertex_shade_float(&setup, camera, model, out_colors);
+		vertex_project_fixed(&setup, camera, model, fixed_out_positions);
+		vertex_shade_fixed(&setup, camera, model, fixed_out_colors);
+
+		for (uint16_t j = 0; j < model->positions_len/3; j++) {
+			float expected[4];
+			reference_project(camera, &relative, sin_yaw, cos_yaw, &model->positions[3*j], expected);
+			const float *actual = &out_positions[4*j];
+			error->screen = fmaxf(error->screen, fabsf(actual[0] - expected[0]));
+			error->screen = fmaxf(error->screen, fabsf(actual[1] - expected[1]));
+			error->depth = fmaxf(error->depth, relative_error(actual[2], expected[2]));
+			error->depth = fmaxf(error->depth, relative_error(actual[3], expected[3]));
+
+			const float *fixed = &fixed_out_positions[4*j];
+			fixed_error->screen = fmaxf(fixed_error->screen, fabsf(fixed[0] - actual[0]));
+			fixed_error->screen = fmaxf(fixed_error->screen, fabsf(fixed[1] - actual[1]));
+			fixed_error->depth = fmaxf(fixed_error->depth, relative_error(fixed[2], actual[2]));
+			fixed_error->depth = fmaxf(fixed_error->depth, relative_error(fixed[3], actual[3]));
+		}
+		for (uint16_t j = 0; j < model->norms_len/3; j++) {
+			float expected[3];
+			reference_shade(camera, sin_yaw, cos_yaw, &model->norms[3*j], expected);
+			for (int k = 0; k < 3; k++) {
+				error->color = fmaxf(error->color, fabsf(out_colors[3*j + k] - expected[k]));
+				fixed_error->color = fmaxf(fixed_error->color, fabsf(fixed_out_colors[3*j + k] - out_colors[3*j + k]));
+			}
+		}
+	}
+}
+
+typedef void (*vertex_stage_t)(const object_setup_t *setup, const vertex_camera_t *camera, const model_t *model, float *out);
+
+static double seconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Seconds to draw the model TIMING_DRAWS times.
+static double time_model(const vertex_camera_t *camera, const model_t *model, vertex_stage_t project, vertex_stage_t shade) {
+	object_setup_t setup;
+	vector3_t relative = {0.f, 12.f, -12.f};
+	vertex_setup_object(&setup, camera, &relative, 0.f, 1.f);
+
+	double start = seconds();
+	for (int i = 0; i < TIMING_DRAWS; i++) {
+		project(&setup, camera, model, out_positions);
+		shade(&setup, camera, model, out_colors);
+	}
+	return seconds() - start;
+}
+
+int main() {
+	vertex_camera_t camera;
+	camera_init(&camera);
+
+	int failures = 0;
+	double float_seconds = 0.0;
+	double fixed_seconds = 0.0;
+	uint32_t vertex_count = 0;
+	for (int i = 0; i < GENERATED_MODEL_COUNT; i++) {
+		const generated_model_t *generated = &generated_models[i];
+		int frame_count = generated->animation != NULL ? sizeof(animation_progress)/sizeof(float) : 1;
+
+		int lod = 0;
+		for (const model_t *model = generated->model; model != NULL; model = model->lod, lod++) {
+			if (model->positions_len > 3*MAX_POSITIONS || model->norms_len > 3*MAX_POSITIONS) {
+				fprintf(stderr, "%s lod %d: too many positions for the test.\n", generated->name, lod);
+				return 1;
+			}
+
+			model_error_t error = {0.f, 0.f, 0.f};
+			model_error_t fixed_error = {0.f, 0.f, 0.f};
+			for (int frame = 0; frame < frame_count; frame++) {
+				if (generated->animation != NULL) {
+					model_animation_decode(generated->animation, animation_progress[frame]);
+					model_animation_decode_fixed(generated->animation, animation_progress[frame]);
+				}
+				check_model(&camera, model, &error, &fixed_error);
+			}
+
+			bool ok = error.screen <= MAX_SCREEN_ERROR && error.color <= MAX_COLOR_ERROR
+				&& fixed_error.screen <= MAX_FIXED_SCREEN_ERROR && fixed_error.color <= MAX_FIXED_COLOR_ERROR;
+			printf("%-14s lod %d: max error %.6f px, depth %.2e, color %.2e, fixed point %.6f px, depth %.2e, color %.2e %s\n",
+				generated->name, lod,
+				error.screen, error.depth, error.color,
+				fixed_error.screen, fixed_error.depth, fixed_error.color,
+				ok ? "ok" : "FAILED");
+			if (!ok) failures++;
+
+			float_seconds += time_model(&camera, model, vertex_project_float, vertex_shade_float);
+			fixed_seconds += time_model(&camera, model, vertex_project_fixed, vertex_shade_fixed);
+			vertex_count += TIMING_DRAWS * (model->positions_len/3);
+		}
+	}
+
+	printf("float:       %.1f ns per vertex\n", 1e9 * float_seconds / vertex_count);
+	printf("fixed point: %.1f ns per vertex\n", 1e9 * fixed_seconds / vertex_count);
+
+	return failures == 0 ? 0 : 1;
+}
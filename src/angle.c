@@ -0,0 +1,97 @@
+#include <math.h>
+#include "angle.h"
+
+// sin over a quarter turn in ANGLE_QUARTER_STEPS steps, one extra so lerping never reads past the end.
+// Generated with [sin(i*pi/2/256) for i in range(257)].
+static const float quarter_sin[ANGLE_QUARTER_STEPS + 1] = {
+	0.0000000f, 0.0061359f, 0.0122715f, 0.0184067f, 0.0245412f, 0.0306748f, 0.0368072f, 0.0429383f,
+	0.0490677f, 0.0551952f, 0.0613207f, 0.0674439f, 0.0735646f, 0.0796824f, 0.0857973f, 0.0919090f,
+	0.0980171f, 0.1041216f, 0.1102222f, 0.1163186f, 0.1224107f, 0.1284981f, 0.1345807f, 0.1406582f,
+	0.1467305f, 0.1527972f, 0.1588581f, 0.1649131f, 0.1709619f, 0.1770042f, 0.1830399f, 0.1890687f,
+	0.1950903f, 0.2011046f, 0.2071114f, 0.2131103f, 0.2191012f, 0.2250839f, 0.2310581f, 0.2370236f,
+	0.2429802f, 0.2489276f, 0.2548657f, 0.2607941f, 0.2667128f, 0.2726214f, 0.2785197f, 0.2844075f,
+	0.2902847f, 0.2961509f, 0.3020059f, 0.3078496f, 0.3136817f, 0.3195020f, 0.3253103f, 0.3311063f,
+	0.3368899f, 0.3426607f, 0.3484187f, 0.3541635f, 0.3598950f, 0.3656130f, 0.3713172f, 0.3770074f,
+	0.3826834f, 0.3883450f, 0.3939920f, 0.3996242f, 0.4052413f, 0.4108432f, 0.4164296f, 0.4220003f,
+	0.4275551f, 0.4330938f, 0.4386162f, 0.4441221f, 0.4496113f, 0.4550836f, 0.4605387f, 0.4659765f,
+	0.4713967f, 0.4767992f, 0.4821838f, 0.4875502f, 0.4928982f, 0.4982277f, 0.5035384f, 0.5088301f,
+	0.5141027f, 0.5193560f, 0.5245897f, 0.5298036f, 0.5349976f, 0.5401715f, 0.5453250f, 0.5504580f,
+	0.5555702f, 0.5606616f, 0.5657318f, 0.5707807f, 0.5758082f, 0.5808140f, 0.5857979f, 0.5907597f,
+	0.5956993f, 0.6006165f, 0.6055110f, 0.6103828f, 0.6152316f, 0.6200572f, 0.6248595f, 0.6296382f,
+	0.6343933f, 0.6391244f, 0.6438315f, 0.6485144f, 0.6531728f, 0.6578067f, 0.6624158f, 0.6669999f,
+	0.6715590f, 0.6760927f, 0.6806010f, 0.6850837f, 0.6895405f, 0.6939715f, 0.6983762f, 0.7027547f,
+	0.7071068f, 0.7114322f, 0.7157308f, 0.7200025f, 0.7242471f, 0.7284644f, 0.7326543f, 0.7368166f,
+	0.7409511f, 0.7450578f, 0.7491364f, 0.7531868f, 0.7572088f, 0.7612024f, 0.7651673f, 0.7691033f,
+	0.7730105f, 0.7768885f, 0.7807372f, 0.7845566f, 0.7883464f, 0.7921066f, 0.7958369f, 0.7995373f,
+	0.8032075f, 0.8068476f, 0.8104572f, 0.8140363f, 0.8175848f, 0.8211025f, 0.8245893f, 0.8280450f,
+	0.8314696f, 0.8348629f, 0.8382247f, 0.8415550f, 0.8448536f, 0.8481203f, 0.8513552f, 0.8545580f,
+	0.8577286f, 0.8608669f, 0.8639729f, 0.8670462f, 0.8700870f, 0.8730950f, 0.8760701f, 0.8790122f,
+	0.8819213f, 0.8847971f, 0.8876396f, 0.8904487f, 0.8932243f, 0.8959662f, 0.8986745f, 0.9013488f,
+	0.9039893f, 0.9065957f, 0.9091680f, 0.9117060f, 0.9142098f, 0.9166791f, 0.9191139f, 0.9215140f,
+	0.9238795f, 0.9262102f, 0.9285061f, 0.9307670f, 0.9329928f, 0.9351835f, 0.9373390f, 0.9394592f,
+	0.9415441f, 0.9435935f, 0.9456073f, 0.9475856f, 0.9495282f, 0.9514350f, 0.9533060f, 0.9551412f,
+	0.9569403f, 0.9587035f, 0.9604305f, 0.9621214f, 0.9637761f, 0.9653944f, 0.9669765f, 0.9685221f,
+	0.9700313f, 0.9715039f, 0.9729400f, 0.9743394f, 0.9757021f, 0.9770281f, 0.9783174f, 0.9795698f,
+	0.9807853f, 0.9819639f, 0.9831055f, 0.9842101f, 0.9852776f, 0.9863081f, 0.9873014f, 0.9882576f,
+	0.9891765f, 0.9900582f, 0.9909026f, 0.9917098f, 0.9924795f, 0.9932119f, 0.9939070f, 0.9945646f,
+	0.9951847f, 0.9957674f, 0.9963126f, 0.9968203f, 0.9972905f, 0.9977231f, 0.9981181f, 0.9984756f,
+	0.9987955f, 0.9990777f, 0.9993224f, 0.9995294f, 0.9996988f, 0.9998306f, 0.9999247f, 0.9999812f,
+	1.0000000f,
+};
+
+float angle_sin(angle_t angle) {
+	// Steps of 1/1024 turn, the low 6 bits lerp between them.
+	uint16_t step = angle >> 6;
+	float t = (angle & 0x3f) * (1.f / 64.f);
+	uint16_t quadrant = step >> 8;
+	uint16_t i = step & 0xff;
+
+	float a, b;
+	if (quadrant & 1) {
+		// Falling half of the hump, walk the table backwards.
+		a = quarter_sin[ANGLE_QUARTER_STEPS - i];
+		b = quarter_sin[ANGLE_QUARTER_STEPS - i - 1];
+	} else {
+		a = quarter_sin[i];
+		b = quarter_sin[i + 1];
+	}
+	float s = a + t * (b - a);
+	return quadrant & 2 ? -s : s;
+}
+
+float angle_cos(angle_t angle) {
+	return angle_sin(angle + ANGLE_QUARTER);
+}
+
+// atan(z) for z in [0, 1], in angle units.
+// 8192 z - z (z - 1) (2552 + 691 z) is within about 0.1 degrees.
+static float unit_atan(float z) {
+	return z * (8192.f + (1.f - z) * (2552.f + 691.f * z));
+}
+
+angle_t angle_atan2(float x, float y) {
+	float ax = fabsf(x);
+	float ay = fabsf(y);
+	if (ax == 0.f && ay == 0.f) return 0;
+
+	// Angle from +y in the first quadrant, folded around 45 degrees to keep the ratio <= 1.
+	float a;
+	if (ax <= ay) {
+		a = unit_atan(ax / ay);
+	} else {
+		a = ANGLE_QUARTER - unit_atan(ay / ax);
+	}
+	if (y < 0.f) a = ANGLE_HALF - a;
+	if (x < 0.f) a = -a;
+	return (angle_t)(int32_t)a;
+}
+
+angle_t angle_step_to(angle_t cur, angle_t target) {
+	angle_diff_t diff = target - cur;
+	return cur + diff / 4;
+}
+
+angle_t angle_lerp(angle_t a, angle_t b, float t) {
+	angle_diff_t diff = b - a;
+	return a + (angle_diff_t)(diff * t);
+}
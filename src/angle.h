@@ -0,0 +1,30 @@
+#ifndef SPOOK64_ANGLE
+#define SPOOK64_ANGLE
+
+#include <stdint.h>
+
+// Binary angles, a full turn is 65536 so they wrap on their own.
+// 0 faces +y and angles grow towards +x, same as atan2f(x, y).
+typedef uint16_t angle_t;
+// Signed difference between two angles, the short way round.
+typedef int16_t angle_diff_t;
+
+#define ANGLE_QUARTER 0x4000
+#define ANGLE_HALF 0x8000
+#define ANGLE_QUARTER_STEPS 256
+
+// Only for constants, the conversion isn't cheap.
+#define ANGLE_FROM_RADIANS(r) ((angle_diff_t)((r) * (32768.f / 3.14159265f)))
+#define ANGLE_TO_RADIANS(a) ((angle_diff_t)(a) * (3.14159265f / 32768.f))
+
+// Table lookups, no trig calls.
+float angle_sin(angle_t angle);
+float angle_cos(angle_t angle);
+// Approximate direction of (x, y), 0 for the zero vector.
+angle_t angle_atan2(float x, float y);
+// Moves a quarter of the way from cur to target, the short way round.
+angle_t angle_step_to(angle_t cur, angle_t target);
+// t of the way from a to b, the short way round.
+angle_t angle_lerp(angle_t a, angle_t b, float t);
+
+#endif
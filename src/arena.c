@@ -0,0 +1,27 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "arena.h"
+
+void arena_init(arena_t *arena, void *buffer, size_t size) {
+	arena->buffer = buffer;
+	arena->size = size;
+	arena->used = 0;
+	arena->peak = 0;
+}
+
+void arena_reset(arena_t *arena) {
+	arena->used = 0;
+}
+
+void *arena_alloc(arena_t *arena, size_t size, size_t align) {
+	size_t start = (arena->used + align - 1) & ~(align - 1);
+	if (start + size > arena->size) {
+		fprintf(stderr, "Arena out of memory, %u of %u bytes used, %u more needed.\n",
+			(unsigned)arena->used, (unsigned)arena->size, (unsigned)size);
+		abort();
+	}
+
+	arena->used = start + size;
+	if (arena->used > arena->peak) arena->peak = arena->used;
+	return arena->buffer + start;
+}
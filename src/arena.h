@@ -0,0 +1,25 @@
+#ifndef SPOOK64_ARENA
+#define SPOOK64_ARENA
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bump allocator over one buffer. Everything is freed at once by arena_reset.
+typedef struct {
+	uint8_t *buffer;
+	size_t size;
+	size_t used;
+	// Most ever used, load_level logs it with the profiler on.
+	size_t peak;
+} arena_t;
+
+void arena_init(arena_t *arena, void *buffer, size_t size);
+void arena_reset(arena_t *arena);
+// Never returns NULL, running out aborts. The check stays on under NDEBUG.
+void *arena_alloc(arena_t *arena, size_t size, size_t align);
+
+#define ARENA_ALLOC_ARRAY(arena, type, count) ((type *)arena_alloc((arena), (count)*sizeof(type), __alignof__(type)))
+// Most an ARENA_ALLOC_ARRAY can take with its padding, for adding up how big a buffer has to be.
+#define ARENA_ARRAY_SIZE(type, count) ((count)*sizeof(type) + __alignof__(type) - 1)
+
+#endif
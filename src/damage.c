@@ -0,0 +1,86 @@
+#include "damage.h"
+
+static inline int16_t min16(int16_t a, int16_t b) { return a < b ? a : b; }
+static inline int16_t max16(int16_t a, int16_t b) { return a > b ? a : b; }
+
+static void add_rect(damage_surface_t *damage, const damage_rect_t *rect) {
+	// Grow a rect it overlaps or touches rather than adding another one.
+	for (int i = 0; i < damage->rect_count; i++) {
+		damage_rect_t *other = &damage->rects[i];
+		if (rect->x0 <= other->x1 && rect->x1 >= other->x0 && rect->y0 <= other->y1 && rect->y1 >= other->y0) {
+			other->x0 = min16(other->x0, rect->x0);
+			other->y0 = min16(other->y0, rect->y0);
+			other->x1 = max16(other->x1, rect->x1);
+			other->y1 = max16(other->y1, rect->y1);
+			return;
+		}
+	}
+
+	if (damage->rect_count < DAMAGE_MAX_RECTS) {
+		damage->rects[damage->rect_count++] = *rect;
+		return;
+	}
+
+	// Out of rects, fold it into the last one.
+	damage_rect_t *last = &damage->rects[DAMAGE_MAX_RECTS - 1];
+	last->x0 = min16(last->x0, rect->x0);
+	last->y0 = min16(last->y0, rect->y0);
+	last->x1 = max16(last->x1, rect->x1);
+	last->y1 = max16(last->y1, rect->y1);
+}
+
+void damage_reset(damage_tracker_t *tracker, int16_t width, int16_t height) {
+	tracker->width = width;
+	tracker->height = height;
+	for (int i = 0; i < DAMAGE_MAX_SURFACES; i++) {
+		tracker->surfaces[i].surface = NULL;
+		tracker->surfaces[i].rect_count = 0;
+	}
+}
+
+void damage_add(damage_tracker_t *tracker, int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+	damage_rect_t rect = {
+		max16(x0, 0),
+		max16(y0, 0),
+		min16(x1, tracker->width),
+		min16(y1, tracker->height),
+	};
+	if (rect.x0 >= rect.x1 || rect.y0 >= rect.y1) return;
+
+	for (int i = 0; i < DAMAGE_MAX_SURFACES; i++) {
+		if (tracker->surfaces[i].surface == NULL) continue;
+		add_rect(&tracker->surfaces[i], &rect);
+	}
+}
+
+damage_surface_t *damage_begin(damage_tracker_t *tracker, const surface_t *surface) {
+	damage_surface_t *free_slot = NULL;
+	for (int i = 0; i < DAMAGE_MAX_SURFACES; i++) {
+		damage_surface_t *damage = &tracker->surfaces[i];
+		if (damage->surface == surface) return damage;
+		if (damage->surface == NULL && free_slot == NULL) free_slot = damage;
+	}
+
+	assertf(free_slot != NULL, "Too many surfaces for damage tracking.");
+
+	// Nothing is known about a new buffer.
+	free_slot->surface = surface;
+	free_slot->rect_count = 1;
+	free_slot->rects[0].x0 = 0;
+	free_slot->rects[0].y0 = 0;
+	free_slot->rects[0].x1 = tracker->width;
+	free_slot->rects[0].y1 = tracker->height;
+	return free_slot;
+}
+
+void damage_clear(damage_surface_t *damage) {
+	damage->rect_count = 0;
+}
+
+bool damage_rect_intersect(damage_rect_t *out, const damage_rect_t *a, const damage_rect_t *b) {
+	out->x0 = max16(a->x0, b->x0);
+	out->y0 = max16(a->y0, b->y0);
+	out->x1 = min16(a->x1, b->x1);
+	out->y1 = min16(a->y1, b->y1);
+	return out->x0 < out->x1 && out->y0 < out->y1;
+}
@@ -0,0 +1,43 @@
+#ifndef SPOOK64_DAMAGE
+#define SPOOK64_DAMAGE
+
+#include "dragon.h"
+
+// One per display buffer, see display_init in main.
+#define DAMAGE_MAX_SURFACES 3
+#define DAMAGE_MAX_RECTS 4
+
+// Pixel rectangle, x1 and y1 are exclusive.
+typedef struct {
+	int16_t x0;
+	int16_t y0;
+	int16_t x1;
+	int16_t y1;
+} damage_rect_t;
+
+typedef struct {
+	const surface_t *surface;
+	uint8_t rect_count;
+	damage_rect_t rects[DAMAGE_MAX_RECTS];
+} damage_surface_t;
+
+// Tracks which parts of each display buffer are out of date.
+// Changed content is added to every buffer, and a buffer's damage
+// is cleared once it has been redrawn.
+typedef struct {
+	int16_t width;
+	int16_t height;
+	damage_surface_t surfaces[DAMAGE_MAX_SURFACES];
+} damage_tracker_t;
+
+// Forgets all buffers, so each one is fully redrawn the next time it's seen.
+void damage_reset(damage_tracker_t *tracker, int16_t width, int16_t height);
+void damage_add(damage_tracker_t *tracker, int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+// Returns the damage of the buffer about to be drawn.
+damage_surface_t *damage_begin(damage_tracker_t *tracker, const surface_t *surface);
+void damage_clear(damage_surface_t *damage);
+
+// Clips a to b, returns false if nothing is left.
+bool damage_rect_intersect(damage_rect_t *out, const damage_rect_t *a, const damage_rect_t *b);
+
+#endif
@@ -0,0 +1,111 @@
+#include <math.h>
+#include <string.h>
+#include "grid.h"
+
+static int clamp_cell(int cell, int count) {
+	if (cell < 0) return 0;
+	if (cell >= count) return count - 1;
+	return cell;
+}
+
+// Same mapping as world2grid_x/y in state.c, scaled down to cells.
+static int column_at(const grid_t *grid, float x) {
+	return clamp_cell((int)floorf(0.5f*(x + grid->level_width) / GRID_CELL_TILES), grid->columns);
+}
+
+static int row_at(const grid_t *grid, float y) {
+	return clamp_cell((int)floorf(0.5f*(grid->level_height - y) / GRID_CELL_TILES), grid->rows);
+}
+
+static void add_entry(grid_t *grid, uint16_t item, int column, int row) {
+	assertf(grid->entry_count < grid->max_entries, "Too many grid entries.");
+	grid_entry_t *entry = &grid->entries[grid->entry_count++];
+	entry->item = item;
+	entry->cell = row*grid->columns + column;
+}
+
+static int level_cell_count(const level_t *level) {
+	int columns = (level->width + GRID_CELL_TILES - 1) / GRID_CELL_TILES;
+	int rows = (level->height + GRID_CELL_TILES - 1) / GRID_CELL_TILES;
+	return columns*rows;
+}
+
+void grid_init(grid_t *grid, const level_t *level, uint16_t max_entries, arena_t *arena) {
+	grid->level_width = level->width;
+	grid->level_height = level->height;
+	grid->columns = (level->width + GRID_CELL_TILES - 1) / GRID_CELL_TILES;
+	grid->rows = (level->height + GRID_CELL_TILES - 1) / GRID_CELL_TILES;
+
+	int cell_count = level_cell_count(level);
+	grid->max_entries = max_entries;
+	grid->entries = ARENA_ALLOC_ARRAY(arena, grid_entry_t, max_entries);
+	grid->cell_starts = ARENA_ALLOC_ARRAY(arena, uint16_t, cell_count + 1);
+	grid->fill = ARENA_ALLOC_ARRAY(arena, uint16_t, cell_count);
+	grid->items = ARENA_ALLOC_ARRAY(arena, uint16_t, max_entries);
+
+	grid_clear(grid);
+}
+
+size_t grid_arena_size(const level_t *level, uint16_t max_entries) {
+	int cell_count = level_cell_count(level);
+	return ARENA_ARRAY_SIZE(grid_entry_t, max_entries)
+		+ ARENA_ARRAY_SIZE(uint16_t, cell_count + 1)
+		+ ARENA_ARRAY_SIZE(uint16_t, cell_count)
+		+ ARENA_ARRAY_SIZE(uint16_t, max_entries);
+}
+
+uint16_t grid_disk_max_cells(float radius) {
+	// A span of d world units touches at most floor(d / cell size) + 2 cells.
+	int span = (int)(2.f*radius / (2.f*GRID_CELL_TILES)) + 2;
+	return span*span;
+}
+
+void grid_clear(grid_t *grid) {
+	grid->entry_count = 0;
+}
+
+void grid_add_point(grid_t *grid, uint16_t item, float x, float y) {
+	add_entry(grid, item, column_at(grid, x), row_at(grid, y));
+}
+
+void grid_add_disk(grid_t *grid, uint16_t item, float x, float y, float radius) {
+	grid_range_t range;
+	grid_range(grid, x, y, radius, &range);
+	for (int row = range.min_row; row <= range.max_row; row++) {
+		for (int column = range.min_column; column <= range.max_column; column++) {
+			add_entry(grid, item, column, row);
+		}
+	}
+}
+
+void grid_finish(grid_t *grid) {
+	// Counting sort by cell, items keep the order they were added in.
+	int cell_count = grid->columns*grid->rows;
+	memset(grid->cell_starts, 0, (cell_count + 1)*sizeof(uint16_t));
+	for (uint16_t i = 0; i < grid->entry_count; i++) {
+		grid->cell_starts[grid->entries[i].cell + 1]++;
+	}
+	for (int i = 0; i < cell_count; i++) {
+		grid->cell_starts[i + 1] += grid->cell_starts[i];
+	}
+
+	memcpy(grid->fill, grid->cell_starts, cell_count*sizeof(uint16_t));
+	for (uint16_t i = 0; i < grid->entry_count; i++) {
+		const grid_entry_t *entry = &grid->entries[i];
+		grid->items[grid->fill[entry->cell]++] = entry->item;
+	}
+}
+
+void grid_range(const grid_t *grid, float x, float y, float radius, grid_range_t *range) {
+	range->min_column = column_at(grid, x - radius);
+	range->max_column = column_at(grid, x + radius);
+	// y is up but rows go down.
+	range->min_row = row_at(grid, y + radius);
+	range->max_row = row_at(grid, y - radius);
+}
+
+const uint16_t *grid_cell_items(const grid_t *grid, int column, int row, uint16_t *count) {
+	int cell = row*grid->columns + column;
+	*count = grid->cell_starts[cell + 1] - grid->cell_starts[cell];
+	return &grid->items[grid->cell_starts[cell]];
+}
@@ -0,0 +1,63 @@
+#ifndef SPOOK64_GRID
+#define SPOOK64_GRID
+
+#include "dragon.h"
+#include "level.h"
+#include "arena.h"
+
+// Level tiles per grid cell along each axis.
+// 3 tiles is 6 world units, about the range of the biggest query.
+#define GRID_CELL_TILES 3
+
+typedef struct {
+	uint16_t item;
+	uint16_t cell;
+} grid_entry_t;
+
+// Items binned by level area, rebuilt every update.
+// Items are small indices into whatever array the caller is binning.
+typedef struct {
+	float level_width;
+	float level_height;
+	uint16_t columns;
+	uint16_t rows;
+
+	uint16_t max_entries;
+	uint16_t entry_count;
+	grid_entry_t *entries;
+
+	// Items sorted by cell, cell i's items start at cell_starts[i].
+	uint16_t *cell_starts;
+	uint16_t *fill;
+	uint16_t *items;
+} grid_t;
+
+// Inclusive range of cells.
+typedef struct {
+	uint16_t min_column;
+	uint16_t max_column;
+	uint16_t min_row;
+	uint16_t max_row;
+} grid_range_t;
+
+// Sizes the grid for the level, the arrays come from the arena.
+void grid_init(grid_t *grid, const level_t *level, uint16_t max_entries, arena_t *arena);
+// Most grid_init can take from the arena.
+size_t grid_arena_size(const level_t *level, uint16_t max_entries);
+// Most cells a disk can overlap wherever it is, for sizing max_entries.
+uint16_t grid_disk_max_cells(float radius);
+
+void grid_clear(grid_t *grid);
+// Adds the item to the cell containing the point.
+void grid_add_point(grid_t *grid, uint16_t item, float x, float y);
+// Adds the item to every cell the disk overlaps.
+void grid_add_disk(grid_t *grid, uint16_t item, float x, float y, float radius);
+// Sorts the items into their cells, call before querying.
+void grid_finish(grid_t *grid);
+
+// Cells overlapping a disk. Points off the level were binned into the nearest edge cell,
+// so the range is clamped the same way.
+void grid_range(const grid_t *grid, float x, float y, float radius, grid_range_t *range);
+const uint16_t *grid_cell_items(const grid_t *grid, int column, int row, uint16_t *count);
+
+#endif
@@ -25,6 +25,10 @@ typedef struct {
 	const uint16_t min_snooper_spawn_duration;
 	const uint16_t max_snooper_spawn_duration;
 
+	// Most entities alive at once, their arrays are carved out of the level arena.
+	const uint16_t max_snooper_count;
+	const uint8_t max_spooker_count;
+
 	const path_graph_t *path_graph;
 
 	const uint8_t *data;
@@ -0,0 +1,220 @@
+#include <string.h>
+#include "level_mesh.h"
+#include "primitive_models.h"
+#include "vertex.h"
+#include "macros.h"
+
+#define MAX_CHUNK_POSITIONS 256
+#define MAX_CHUNK_TEXCOORDS 64
+#define MAX_CHUNK_NORMS 16
+#define MAX_CHUNK_VERTS 256
+#define MAX_CHUNK_TRIS (3*2*4*LEVEL_CHUNK_WIDTH)
+#define MAX_CHUNK_STRIPS (5*4*LEVEL_CHUNK_WIDTH)
+#define MAX_PART_VERTS 16
+
+typedef struct {
+	uint8_t mask;
+	level_layer_t layer;
+	const model_t *model;
+} tile_part_t;
+
+static const tile_part_t tile_parts[] = {
+	{0x01, LEVEL_LAYER_FLOOR, &floor_model},
+	{0x02, LEVEL_LAYER_WALL, &wall_model},
+	{0x04, LEVEL_LAYER_WALL, &wall_left_model},
+	{0x08, LEVEL_LAYER_WALL, &wall_right_model},
+	{0x20, LEVEL_LAYER_WALL, &fall_model},
+	{0x10, LEVEL_LAYER_ROOF, &roof_model},
+};
+
+// Scratch space for the chunk being built.
+static float build_positions[3*MAX_CHUNK_POSITIONS];
+static float build_texcoords[2*MAX_CHUNK_TEXCOORDS];
+static float build_norms[3*MAX_CHUNK_NORMS];
+static uint16_t build_verts[3*MAX_CHUNK_VERTS];
+static uint16_t build_tris[MAX_CHUNK_TRIS];
+static uint16_t build_strips[MAX_CHUNK_STRIPS];
+
+// Finds an existing matching value or appends a new one.
+// Returns the index of the value in the array.
+static uint16_t add_unique(void *values, uint16_t *len, uint16_t max_len, const void *value, size_t size) {
+	uint8_t *bytes = values;
+	for (uint16_t i = 0; i < *len; i++) {
+		if (memcmp(bytes + i*size, value, size) == 0) {
+			return i;
+		}
+	}
+
+	assertf(*len < max_len, "Too many vertices in level chunk.");
+	memcpy(bytes + *len*size, value, size);
+	return (*len)++;
+}
+
+// Merges the layer's parts into the build arrays, and sets out's lengths to match.
+static void merge_chunk_layer(model_t *out, const level_t *level, uint16_t row, uint16_t min_column, uint16_t max_column, level_layer_t layer) {
+	uint16_t position_count = 0;
+	uint16_t texcoord_count = 0;
+	uint16_t norm_count = 0;
+	uint16_t vert_count = 0;
+	uint16_t tris_len = 0;
+	uint16_t strips_len = 0;
+
+	float tile_y = level->height - 1 - 2.f*row;
+	for (uint16_t column = min_column; column < max_column; column++) {
+		uint8_t d = level->data[level->width*row + column];
+		float tile_x = -level->width + 1 + 2.f*column;
+
+		for (int part_index = 0; part_index < ARRAY_LENGTH(tile_parts); part_index++) {
+			const tile_part_t *part = &tile_parts[part_index];
+			if (part->layer != layer || !(d & part->mask)) continue;
+
+			const model_t *model = part->model;
+
+			// Map the part's vertices to chunk vertices.
+			uint16_t vert_map[MAX_PART_VERTS];
+			assertf(model->verts_len <= 3*MAX_PART_VERTS, "Too many vertices in level part.");
+			for (uint16_t i = 0; i < model->verts_len; i += 3) {
+				const float *in_position = model->positions + 3*model->verts[i];
+				float position[3] = {
+					in_position[0] + tile_x,
+					in_position[1] + tile_y,
+					in_position[2],
+				};
+
+				uint16_t vert[3] = {
+					add_unique(build_positions, &position_count, MAX_CHUNK_POSITIONS, position, 3*sizeof(float)),
+					add_unique(build_texcoords, &texcoord_count, MAX_CHUNK_TEXCOORDS, model->texcoords + 2*model->verts[i+1], 2*sizeof(float)),
+					add_unique(build_norms, &norm_count, MAX_CHUNK_NORMS, model->norms + 3*model->verts[i+2], 3*sizeof(float)),
+				};
+				vert_map[i/3] = add_unique(build_verts, &vert_count, MAX_CHUNK_VERTS, vert, sizeof(vert));
+			}
+
+			assertf(tris_len + model->tris_len <= MAX_CHUNK_TRIS, "Too many triangles in level chunk.");
+			for (uint16_t i = 0; i < model->tris_len; i++) {
+				build_tris[tris_len++] = vert_map[model->tris[i]];
+			}
+
+			if (model->strips_len == 0) continue;
+			assertf(strips_len + model->strips_len + 1 <= MAX_CHUNK_STRIPS, "Too many strips in level chunk.");
+			if (strips_len != 0) {
+				build_strips[strips_len++] = STRIP_RESTART;
+			}
+			for (uint16_t i = 0; i < model->strips_len; i++) {
+				uint16_t index = model->strips[i];
+				build_strips[strips_len++] = index == STRIP_RESTART ? STRIP_RESTART : vert_map[index];
+			}
+		}
+	}
+
+	out->positions_len = 3*position_count;
+	out->texcoords_len = 2*texcoord_count;
+	out->norms_len = 3*norm_count;
+	out->verts_len = 3*vert_count;
+	out->tris_len = tris_len;
+	out->strips_len = strips_len;
+}
+
+// One allocation per layer - floats first, then the indices.
+static size_t chunk_layer_bytes(const model_t *layer) {
+	size_t float_count = layer->positions_len + layer->texcoords_len + layer->norms_len;
+	size_t index_count = layer->verts_len + layer->tris_len + layer->strips_len;
+	return float_count*sizeof(float) + index_count*sizeof(uint16_t);
+}
+
+static void build_chunk_layer(arena_t *arena, model_t *out, const level_t *level, uint16_t row, uint16_t min_column, uint16_t max_column, level_layer_t layer) {
+	merge_chunk_layer(out, level, row, min_column, max_column, layer);
+
+	if (out->verts_len == 0) {
+		out->positions = NULL;
+		out->texcoords = NULL;
+		out->norms = NULL;
+		out->verts = NULL;
+		out->tris = NULL;
+		out->strips = NULL;
+		out->fixed_positions = NULL;
+		out->fixed_norms = NULL;
+		return;
+	}
+
+	float *floats = arena_alloc(arena, chunk_layer_bytes(out), __alignof__(float));
+
+	out->positions = floats;
+	out->texcoords = out->positions + out->positions_len;
+	out->norms = out->texcoords + out->texcoords_len;
+	out->verts = (uint16_t *)(out->norms + out->norms_len);
+	out->tris = out->verts + out->verts_len;
+	out->strips = out->tris + out->tris_len;
+
+	memcpy(out->positions, build_positions, out->positions_len*sizeof(float));
+	memcpy(out->texcoords, build_texcoords, out->texcoords_len*sizeof(float));
+	memcpy(out->norms, build_norms, out->norms_len*sizeof(float));
+	memcpy(out->verts, build_verts, out->verts_len*sizeof(uint16_t));
+	memcpy(out->tris, build_tris, out->tris_len*sizeof(uint16_t));
+	memcpy(out->strips, build_strips, out->strips_len*sizeof(uint16_t));
+
+	model_compute_bounds(out);
+
+#if RENDER_FIXED_POINT
+	out->fixed_positions = ARENA_ALLOC_ARRAY(arena, fixed_t, out->positions_len);
+	out->fixed_norms = ARENA_ALLOC_ARRAY(arena, fixed_t, out->norms_len);
+	model_update_fixed(out);
+#else
+	out->fixed_positions = NULL;
+	out->fixed_norms = NULL;
+#endif
+}
+
+static uint16_t chunk_columns(const level_t *level) {
+	return (level->width + LEVEL_CHUNK_WIDTH - 1) / LEVEL_CHUNK_WIDTH;
+}
+
+static uint16_t chunk_max_column(const level_t *level, uint16_t min_column) {
+	uint16_t max_column = min_column + LEVEL_CHUNK_WIDTH;
+	return max_column > level->width ? level->width : max_column;
+}
+
+int level_mesh_chunk_count(const level_t *level) {
+	return chunk_columns(level)*level->height;
+}
+
+void level_mesh_build(level_mesh_t *mesh, const level_t *level, arena_t *arena) {
+	mesh->chunk_columns = chunk_columns(level);
+	mesh->chunk_rows = level->height;
+	mesh->chunks = ARENA_ALLOC_ARRAY(arena, level_chunk_t, level_mesh_chunk_count(level));
+
+	level_chunk_t *chunk = mesh->chunks;
+	for (uint16_t row = 0; row < mesh->chunk_rows; row++) {
+		for (uint16_t chunk_column = 0; chunk_column < mesh->chunk_columns; chunk_column++) {
+			uint16_t min_column = chunk_column * LEVEL_CHUNK_WIDTH;
+			uint16_t max_column = chunk_max_column(level, min_column);
+
+			chunk->min_x = -level->width + 1 + 2.f*min_column;
+			chunk->max_x = -level->width + 1 + 2.f*(max_column - 1);
+			chunk->y = level->height - 1 - 2.f*row;
+
+			for (int layer = 0; layer < LEVEL_LAYER_COUNT; layer++) {
+				build_chunk_layer(arena, &chunk->layers[layer], level, row, min_column, max_column, layer);
+			}
+			chunk++;
+		}
+	}
+}
+
+size_t level_mesh_arena_size(const level_t *level) {
+	size_t size = ARENA_ARRAY_SIZE(level_chunk_t, level_mesh_chunk_count(level));
+	for (uint16_t row = 0; row < level->height; row++) {
+		for (uint16_t min_column = 0; min_column < level->width; min_column += LEVEL_CHUNK_WIDTH) {
+			for (int layer = 0; layer < LEVEL_LAYER_COUNT; layer++) {
+				model_t merged;
+				merge_chunk_layer(&merged, level, row, min_column, chunk_max_column(level, min_column), layer);
+				if (merged.verts_len == 0) continue;
+
+				size += chunk_layer_bytes(&merged) + __alignof__(float) - 1;
+#if RENDER_FIXED_POINT
+				size += ARENA_ARRAY_SIZE(fixed_t, merged.positions_len) + ARENA_ARRAY_SIZE(fixed_t, merged.norms_len);
+#endif
+			}
+		}
+	}
+	return size;
+}
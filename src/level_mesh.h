@@ -0,0 +1,40 @@
+#ifndef SPOOK64_LEVEL_MESH
+#define SPOOK64_LEVEL_MESH
+
+#include "render.h"
+#include "level.h"
+#include "arena.h"
+
+// Tiles per chunk along x. Each chunk is one row of the level.
+#define LEVEL_CHUNK_WIDTH 8
+
+typedef enum {
+	LEVEL_LAYER_FLOOR=0,
+	LEVEL_LAYER_WALL=1,
+	LEVEL_LAYER_ROOF=2,
+	LEVEL_LAYER_COUNT=3,
+} level_layer_t;
+
+typedef struct {
+	// World-space centers of the first and last tile in the chunk.
+	float min_x;
+	float max_x;
+	float y;
+
+	// Merged geometry in world space, one model per texture.
+	model_t layers[LEVEL_LAYER_COUNT];
+} level_chunk_t;
+
+typedef struct {
+	uint16_t chunk_columns;
+	uint16_t chunk_rows;
+	level_chunk_t *chunks;
+} level_mesh_t;
+
+// Allocates from the arena, the mesh lives until it's reset.
+void level_mesh_build(level_mesh_t *mesh, const level_t *level, arena_t *arena);
+// Most level_mesh_build can take from the arena. Merges every chunk to count it, so it's as slow as a build.
+size_t level_mesh_arena_size(const level_t *level);
+int level_mesh_chunk_count(const level_t *level);
+
+#endif
@@ -142,6 +142,7 @@ static const level_t level1 = {
 	17, 17, // size
 	15, 3,  // target
 	60, 120, // spawn duration
+	32, 1,  // capacity
 	&level1_graph,
 	level1_data,
 	ARRAY_LENGTH(level1_lights),
@@ -361,6 +362,7 @@ static const level_t level2 = {
 	17, 17, // size
 	25, 3,  // target
 	60, 120, // spawn duration
+	32, 1,  // capacity
 	&level2_graph,
 	level2_data,
 	ARRAY_LENGTH(level2_lights),
@@ -555,6 +557,7 @@ static const level_t level3 = {
 	17, 17, // size
 	40, 3,  // target
 	60, 90, // spawn duration
+	32, 1,  // capacity
 	&level3_graph,
 	level3_data,
 	ARRAY_LENGTH(level3_lights),
@@ -80,7 +80,7 @@ static uint32_t __rdp_load_texture( uint32_t texslot, uint32_t texloc, mirror_t
     return tmem_pitch * real_height;
 }
 
-uint32_t rdp_load_texture_stride_hax( uint32_t texslot, uint32_t texloc, mirror_t mirror, sprite_t *sprite, void *buffer, int offset )
+static inline uint32_t rdp_load_texture_stride_hax( uint32_t texslot, uint32_t texloc, mirror_t mirror, sprite_t *sprite, void *buffer, int offset )
 {
     if( !sprite ) { return 0; }
 
@@ -96,7 +96,7 @@ uint32_t rdp_load_texture_stride_hax( uint32_t texslot, uint32_t texloc, mirror_
     return __rdp_load_texture( texslot, texloc, mirror, sprite, buffer, sl, tl, sh, th );
 }
 
-void rdp_load_texture_hax(tex_format_t format, uint32_t hbits, uint32_t wbits, void *buff) {
+static inline void rdp_load_texture_hax(tex_format_t format, uint32_t hbits, uint32_t wbits, void *buff) {
 	uint32_t width = 1 << hbits;
 	uint32_t height = 1 << wbits;
 	uint32_t tmem_pitch = width * TEX_FORMAT_BITDEPTH(format) / 8;
@@ -2,6 +2,7 @@
 #include "dragon.h"
 #include <malloc.h>
 #include "render.h"
+#include "vertex.h"
 #include "_generated_models.h"
 #include "primitive_models.h"
 #include "model_viewer.h"
@@ -9,14 +10,28 @@
 #include "sfx.h"
 #include "instructions.h"
 #include "end_screen.h"
+#include "profile.h"
 
 model_t *test_models[] = {
 	&floor_model,
 };
 
+static void update_audio() {
+	profile_begin(PROFILE_AUDIO);
+	audio_update();
+	profile_end(PROFILE_AUDIO);
+}
+
+static void update_state() {
+	profile_begin(PROFILE_UPDATE);
+	state_update();
+	profile_end(PROFILE_UPDATE);
+}
+
 int main()
 {
     display_init(RESOLUTION_320x240, DEPTH_16_BPP, 3, GAMMA_NONE, ANTIALIAS_RESAMPLE);
+	// Also sends stderr to the ISViewer, for logs that have to work with NDEBUG.
 	debug_init(DEBUG_FEATURE_LOG_ISVIEWER);
 	debugf("debug test!\n");
 
@@ -31,15 +46,18 @@ int main()
     rdp_init();
     rdpq_debug_start();
 
+#if !RENDER_FIXED_POINT
 	// TODO : for some reason it's generating underflow exceptions despite C1_FCR31_FS being set?
 	// Disable underflow exceptions.
 	// (C1_FCR31_FS is supposed to flush denormals to 0?)
+	// Kept for the float vertex pipeline until it's been seen not to happen on hardware without it.
 	C1_WRITE_FCR31(
 		C1_ENABLE_OVERFLOW
 		//| C1_ENABLE_UNDERFLOW
 		| C1_ENABLE_DIV_BY_0
 		| C1_ENABLE_INVALID_OP
 		| C1_FCR31_FS);
+#endif
 
 	renderer_init();
 	sfx_init();
@@ -48,36 +66,35 @@ int main()
 
 	state_init();
 
-	const uint32_t ticks_per_frame = 1562500LL;
-	const uint32_t max_delay = 156250LL;
+	// The simulation steps at a fixed 30Hz. Frames are drawn whenever a display buffer is free,
+	// interpolated between the last two steps, so they can run at 60Hz or drop without judder.
+	const uint32_t ticks_per_update = 1562500LL;
+	// Past this many steps behind, drop the time instead of trying to catch up.
+	const uint32_t max_pending_ticks = 4*ticks_per_update;
 
-	uint32_t last_update = (uint32_t)timer_ticks();
-	uint32_t extra_ticks = 0;
+	uint32_t last_time = (uint32_t)timer_ticks();
+	uint32_t pending_ticks = 0;
 
     while (game_state.status != GAME_STATUS_BEAT)
     {
-		// Wait for next frame.
-		uint32_t now;
-		do {
-			audio_update();
-			now = (uint32_t)timer_ticks();
-		} while (now - last_update < ticks_per_frame);
-
-		last_update += ticks_per_frame;
-		if (now - last_update > max_delay) {
-			extra_ticks += now - last_update;
+		update_audio();
+
+		uint32_t now = (uint32_t)timer_ticks();
+		pending_ticks += now - last_time;
+		last_time = now;
+		if (pending_ticks > max_pending_ticks) {
 			// Slowdown!
-			last_update = now;
+			pending_ticks = max_pending_ticks;
+		}
+
+		while (pending_ticks >= ticks_per_update) {
+			pending_ticks -= ticks_per_update;
+			update_state();
+			update_audio();
 		}
 
-		render();
-		audio_update();
-		state_update();
-		// Update the state at 30fps regardless of graphics framerate.
-		while (extra_ticks >= ticks_per_frame) {
-			extra_ticks -= ticks_per_frame;
-			audio_update();
-			state_update();
+		if (render(pending_ticks / (float)ticks_per_update)) {
+			profile_frame_end();
 		}
     }
 
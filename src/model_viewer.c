@@ -30,10 +30,10 @@ void update_model_viewer(model_viewer_t *viewer) {
 	}
 
 	if (ckeys.c[0].left) {
-		viewer->transform.rotation_z -= 0.05f;
+		viewer->transform.rotation_z -= ANGLE_FROM_RADIANS(0.05f);
 	}
 	if (ckeys.c[0].right) {
-		viewer->transform.rotation_z += 0.05f;
+		viewer->transform.rotation_z += ANGLE_FROM_RADIANS(0.05f);
 	}
 }
 
@@ -44,8 +44,8 @@ void render_model_viewer(model_viewer_t *viewer) {
 	} while (disp == NULL);
 
 	set_camera_pitch(viewer->pitchiness * 0.5f*(float)M_PI);
-	game_state.camera_position.y = viewer->pitchiness * -7.0f;
-	game_state.camera_position.z = 1.0f + 6.0f * (1.0f - viewer->pitchiness);
+	vector3_t camera_position = {0.0f, viewer->pitchiness * -7.0f, 1.0f + 6.0f * (1.0f - viewer->pitchiness)};
+	set_camera_position(&camera_position);
 
 	// Clear the z buffer.
 	clear_z_buffer();
@@ -75,15 +75,11 @@ void render_model_viewer(model_viewer_t *viewer) {
 }
 
 void show_model_viewer(int model_count, model_t **models, char *sprite_path) {
-	game_state.camera_position.x = 0.0f;
-	game_state.camera_position.y = 0.0f;
-	game_state.camera_position.z = 5.0f;
-
 	model_viewer_t viewer;
 	viewer.transform.position.x = 0.0f;
 	viewer.transform.position.y = 0.0f;
 	viewer.transform.position.z = 0.0f;
-	viewer.transform.rotation_z = 0.0f;
+	viewer.transform.rotation_z = 0;
 	viewer.sprite = sprite_load(sprite_path);
 	viewer.pitchiness = 0.0f;
 
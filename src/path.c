@@ -4,24 +4,24 @@
 #include "rand.h"
 #include "debug.h"
 
-#define MAX_NODE_COUNT 64
-#define MAX_EDGE_COUNT 128
-#define MAX_START_NODE_COUNT 16
-
 static const path_graph_t *path_graph = NULL;
 
-static int16_t child_counts[MAX_NODE_COUNT];
-static int16_t children_starts[MAX_NODE_COUNT];
-static int16_t children[MAX_EDGE_COUNT];
-static int16_t start_nodes[MAX_START_NODE_COUNT];
+// Sized by the graph, see path_set_graph.
+static int16_t *child_counts;
+static int16_t *children_starts;
+static int16_t *children;
+static int16_t *start_nodes;
 static int16_t start_node_count;
 
-void path_set_graph(const path_graph_t *graph) {
-	assertf(graph->node_count <= MAX_NODE_COUNT, "Too many nodes.");
-	assertf(graph->edge_count <= MAX_EDGE_COUNT, "Too many edges.");
-
+void path_set_graph(const path_graph_t *graph, arena_t *arena) {
 	path_graph = graph;
 
+	child_counts = ARENA_ALLOC_ARRAY(arena, int16_t, graph->node_count);
+	children_starts = ARENA_ALLOC_ARRAY(arena, int16_t, graph->node_count);
+	children = ARENA_ALLOC_ARRAY(arena, int16_t, graph->edge_count);
+	// Every node could be a start node.
+	start_nodes = ARENA_ALLOC_ARRAY(arena, int16_t, graph->node_count);
+
 	// Compute child counts.
 	for (int16_t i = 0; i < graph->node_count; i++) {
 		child_counts[i] = 0;
@@ -52,12 +52,15 @@ void path_set_graph(const path_graph_t *graph) {
 	start_node_count = 0;
 	for (int16_t i = 0; i < graph->node_count; i++) {
 		if (graph->nodes[i].waypoint_ancestor < 0) {
-			assertf(start_node_count < MAX_START_NODE_COUNT, "Too many start nodes.");
 			start_nodes[start_node_count++] = i;
 		}
 	}
 }
 
+size_t path_graph_arena_size(const path_graph_t *graph) {
+	return 3*ARENA_ARRAY_SIZE(int16_t, graph->node_count) + ARENA_ARRAY_SIZE(int16_t, graph->edge_count);
+}
+
 void path_follower_init(path_follower_t *follower) {
 	follower->dest_index = start_nodes[RANDN(start_node_count)];
 	follower->src_index = -1;
@@ -2,8 +2,9 @@
 #define SPOOK64_PATH
 
 #include "vector.h"
-#include "render.h"
+#include "dragon.h"
 #include "macros.h"
+#include "arena.h"
 
 typedef struct {
 	int16_t waypoint_ancestor;
@@ -31,7 +32,10 @@ typedef struct {
 	vector2_t position;
 } path_follower_t;
 
-void path_set_graph(const path_graph_t *graph);
+// The child lists are built in the arena, they live until it's reset.
+void path_set_graph(const path_graph_t *graph, arena_t *arena);
+// Most path_set_graph can take from the arena.
+size_t path_graph_arena_size(const path_graph_t *graph);
 void path_follower_init(path_follower_t *follower);
 bool path_follow(path_follower_t *follower, float speed);
 
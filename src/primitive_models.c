@@ -1,5 +1,6 @@
 #include "render.h"
 #include "primitive_models.h"
+#include "vertex.h"
 
 // x, y, z, u, v, 1/w
 static float floor_positions[] = {
@@ -20,12 +21,21 @@ static float floor_norms[] = {
 	0.0f, 0.0f, 0.0f,
 };
 
-static uint16_t floor_tris[] = {
-	0, 0, 0, 6, 4, 0, 3, 2, 0,
-	3, 2, 0, 6, 4, 0, 9, 6, 0,
+// All of the primitives are quads with one vertex per corner.
+static uint16_t quad_verts[] = {
+	0, 0, 0,
+	1, 1, 0,
+	2, 2, 0,
+	3, 3, 0,
 };
 
-model_t floor_model = MODEL(floor_positions, floor_texcoords, floor_norms, floor_tris);
+static uint16_t quad_tris[] = {};
+
+static uint16_t quad_strips[] = {
+	0, 2, 1, 3,
+};
+
+model_t floor_model = MODEL(floor_positions, floor_texcoords, floor_norms, quad_verts, quad_tris, quad_strips);
 
 static float wall_positions[] = {
 	-1.f, -1.f, 0.0f,
@@ -45,12 +55,7 @@ static float wall_norms[] = {
 	0.0f, 0.0f, 0.0f,
 };
 
-static uint16_t wall_tris[] = {
-	0, 0, 0, 6, 4, 0, 3, 2, 0,
-	3, 2, 0, 6, 4, 0, 9, 6, 0,
-};
-
-model_t wall_model = MODEL(wall_positions, wall_texcoords, wall_norms, wall_tris);
+model_t wall_model = MODEL(wall_positions, wall_texcoords, wall_norms, quad_verts, quad_tris, quad_strips);
 
 
 static float fall_positions[] = {
@@ -60,7 +65,7 @@ static float fall_positions[] = {
 	1.f, 1.f, 0.0f,
 };
 
-model_t fall_model = MODEL(fall_positions, wall_texcoords, wall_norms, wall_tris);
+model_t fall_model = MODEL(fall_positions, wall_texcoords, wall_norms, quad_verts, quad_tris, quad_strips);
 
 static float wall_left_positions[] = {
 	-1.f, 1.f, 0.0f,
@@ -69,7 +74,7 @@ static float wall_left_positions[] = {
 	-1.f, -1.f, 2.0f,
 };
 
-model_t wall_left_model = MODEL(wall_left_positions, wall_texcoords, wall_norms, wall_tris);
+model_t wall_left_model = MODEL(wall_left_positions, wall_texcoords, wall_norms, quad_verts, quad_tris, quad_strips);
 
 static float wall_right_positions[] = {
 	1.f, -1.f, 0.0f,
@@ -78,7 +83,7 @@ static float wall_right_positions[] = {
 	1.f, 1.f, 2.0f,
 };
 
-model_t wall_right_model = MODEL(wall_right_positions, wall_texcoords, wall_norms, wall_tris);
+model_t wall_right_model = MODEL(wall_right_positions, wall_texcoords, wall_norms, quad_verts, quad_tris, quad_strips);
 
 static float roof_positions[] = {
 	-1.f, -1.f, 2.0f,
@@ -87,7 +92,7 @@ static float roof_positions[] = {
 	1.f, 1.f, 2.0f,
 };
 
-model_t roof_model = MODEL(roof_positions, floor_texcoords, floor_norms, floor_tris);
+model_t roof_model = MODEL(roof_positions, floor_texcoords, floor_norms, quad_verts, quad_tris, quad_strips);
 
 static float light_positions[] = {
 	-0.75f, 0.5f, 0.0f,
@@ -106,12 +111,7 @@ static float light_norms[] = {
 	0.0f, 0.0f, 0.0f,
 };
 
-static uint16_t light_tris[] = {
-	0, 0, 0, 6, 4, 0, 3, 2, 0,
-	3, 2, 0, 6, 4, 0, 9, 6, 0,
-};
-
-model_t light_model = MODEL(light_positions, light_texcoords, light_norms, light_tris);
+model_t light_model = MODEL(light_positions, light_texcoords, light_norms, quad_verts, quad_tris, quad_strips);
 
 
 static float small_square_positions[] = {
@@ -121,4 +121,26 @@ static float small_square_positions[] = {
 	0.2f, 0.2f, 0.0f,
 };
 
-model_t small_square_model = MODEL(small_square_positions, floor_texcoords, floor_norms, floor_tris);
\ No newline at end of file
+model_t small_square_model = MODEL(small_square_positions, floor_texcoords, floor_norms, quad_verts, quad_tris, quad_strips);
+
+void primitive_models_init() {
+	model_compute_bounds(&floor_model);
+	model_compute_bounds(&wall_model);
+	model_compute_bounds(&fall_model);
+	model_compute_bounds(&wall_left_model);
+	model_compute_bounds(&wall_right_model);
+	model_compute_bounds(&roof_model);
+	model_compute_bounds(&light_model);
+	model_compute_bounds(&small_square_model);
+
+#if RENDER_FIXED_POINT
+	model_update_fixed(&floor_model);
+	model_update_fixed(&wall_model);
+	model_update_fixed(&fall_model);
+	model_update_fixed(&wall_left_model);
+	model_update_fixed(&wall_right_model);
+	model_update_fixed(&roof_model);
+	model_update_fixed(&light_model);
+	model_update_fixed(&small_square_model);
+#endif
+}
\ No newline at end of file
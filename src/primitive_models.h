@@ -1,3 +1,5 @@
+#include "render.h"
+
 extern model_t floor_model;
 extern model_t wall_model;
 extern model_t fall_model;
@@ -7,3 +9,5 @@ extern model_t roof_model;
 
 extern model_t light_model;
 extern model_t small_square_model;
+
+void primitive_models_init();
@@ -0,0 +1,137 @@
+#include "profile.h"
+#include <stdio.h>
+#include "trace.h"
+
+// RDP command unit registers. The counters run at the RCP clock and are 24 bits wide,
+// which is plenty for one frame.
+#define DPC_STATUS ((volatile uint32_t *)0xA410000C)
+#define DPC_CLOCK ((volatile uint32_t *)0xA4100010)
+#define DPC_BUFBUSY ((volatile uint32_t *)0xA4100014)
+#define DPC_COUNTER_MASK 0xffffff
+// Writing these bits to DPC_STATUS resets the tmem, pipe, buffer busy and clock counters.
+#define DPC_RESET_COUNTERS (0x40 | 0x80 | 0x100 | 0x200)
+#define RCP_CLOCKS_PER_US 62.5f
+
+typedef struct {
+	uint32_t start;
+	uint32_t frame_ticks;
+
+	uint32_t window_min;
+	uint32_t window_max;
+	uint64_t window_sum;
+} profile_timer_t;
+
+static const char *phase_names[PROFILE_PHASE_COUNT] = {
+	"update",
+	"light",
+	"level",
+	"entity",
+	"hud",
+	"audio",
+	"rdp",
+	"frame",
+};
+
+static profile_timer_t timers[PROFILE_PHASE_COUNT];
+static profile_stats_t stats[PROFILE_PHASE_COUNT];
+static uint32_t last_us[PROFILE_PHASE_COUNT];
+static uint16_t resolution_width;
+static uint16_t resolution_height;
+static uint16_t window_frame_count;
+static uint32_t last_frame_end;
+static bool enabled = false;
+
+void profile_begin(profile_phase_t phase) {
+	timers[phase].start = TICKS_READ();
+}
+
+void profile_end(profile_phase_t phase) {
+	profile_timer_t *timer = &timers[phase];
+	uint32_t now = TICKS_READ();
+	timer->frame_ticks += now - timer->start;
+	trace_record((trace_scope_t)phase, timer->start, now);
+}
+
+static uint32_t read_rdp_busy_us() {
+	uint32_t busy = *DPC_BUFBUSY & DPC_COUNTER_MASK;
+	*DPC_STATUS = DPC_RESET_COUNTERS;
+	return (uint32_t)(busy / RCP_CLOCKS_PER_US);
+}
+
+void profile_frame_end() {
+	uint32_t now = TICKS_READ();
+	timers[PROFILE_FRAME].frame_ticks = now - last_frame_end;
+	last_frame_end = now;
+	trace_frame();
+
+	// The RDP can still be working on this frame, that part gets counted in the next one.
+	// It evens out over the window.
+	uint32_t rdp_us = read_rdp_busy_us();
+
+	for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+		profile_timer_t *timer = &timers[i];
+		uint32_t us = i == PROFILE_RDP ? rdp_us : (uint32_t)TICKS_TO_US(timer->frame_ticks);
+		timer->frame_ticks = 0;
+		last_us[i] = us;
+
+		if (window_frame_count == 0 || us < timer->window_min) timer->window_min = us;
+		if (window_frame_count == 0 || us > timer->window_max) timer->window_max = us;
+		if (window_frame_count == 0) timer->window_sum = 0;
+		timer->window_sum += us;
+	}
+
+	window_frame_count++;
+	if (window_frame_count < PROFILE_WINDOW_FRAMES) return;
+	window_frame_count = 0;
+
+	for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+		stats[i].min_us = timers[i].window_min;
+		stats[i].avg_us = timers[i].window_sum / PROFILE_WINDOW_FRAMES;
+		stats[i].max_us = timers[i].window_max;
+	}
+
+	if (!enabled) return;
+
+	fprintf(stderr, "profile over %d frames at %ux%u, min/avg/max us:\n", PROFILE_WINDOW_FRAMES, resolution_width, resolution_height);
+	for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+		fprintf(stderr, "  %-6s %6lu %6lu %6lu\n", phase_names[i],
+			(unsigned long)stats[i].min_us, (unsigned long)stats[i].avg_us, (unsigned long)stats[i].max_us);
+	}
+}
+
+const profile_stats_t *profile_get_stats(profile_phase_t phase) {
+	return &stats[phase];
+}
+
+uint32_t profile_last_us(profile_phase_t phase) {
+	return last_us[phase];
+}
+
+void profile_set_resolution(uint16_t width, uint16_t height) {
+	resolution_width = width;
+	resolution_height = height;
+}
+
+void profile_toggle() {
+	enabled = !enabled;
+}
+
+bool profile_enabled() {
+	return enabled;
+}
+
+int profile_draw_overlay(surface_t *disp, int x, int y) {
+	char line[40];
+	snprintf(line, sizeof(line), "scene %ux%u", resolution_width, resolution_height);
+	graphics_draw_text(disp, x, y, line);
+	y += 8;
+	graphics_draw_text(disp, x, y, "phase    min   avg   max");
+	y += 8;
+	for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+		snprintf(line, sizeof(line), "%-6s %5lu %5lu %5lu", phase_names[i],
+			(unsigned long)stats[i].min_us, (unsigned long)stats[i].avg_us, (unsigned long)stats[i].max_us);
+		graphics_draw_text(disp, x, y, line);
+		y += 8;
+	}
+	return y;
+}
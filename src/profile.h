@@ -0,0 +1,46 @@
+#ifndef SPOOK64_PROFILE
+#define SPOOK64_PROFILE
+
+#include "dragon.h"
+
+typedef enum {
+	PROFILE_UPDATE=0,
+	PROFILE_LIGHT=1,
+	PROFILE_LEVEL=2,
+	PROFILE_ENTITIES=3,
+	PROFILE_HUD=4,
+	PROFILE_AUDIO=5,
+	// These two aren't timed with profile_begin/profile_end.
+	// RDP is read from the RDP's own busy counter, frame is the time between profile_frame_end calls.
+	PROFILE_RDP=6,
+	PROFILE_FRAME=7,
+	PROFILE_PHASE_COUNT=8,
+} profile_phase_t;
+
+// Frames per min/avg/max window.
+#define PROFILE_WINDOW_FRAMES 60
+
+typedef struct {
+	uint32_t min_us;
+	uint32_t avg_us;
+	uint32_t max_us;
+} profile_stats_t;
+
+// Timers accumulate, so a phase can be timed in several pieces per frame.
+void profile_begin(profile_phase_t phase);
+void profile_end(profile_phase_t phase);
+// Call once per displayed frame.
+// Every PROFILE_WINDOW_FRAMES frames the stats are updated and, when enabled, logged.
+void profile_frame_end();
+const profile_stats_t *profile_get_stats(profile_phase_t phase);
+// Time spent in the phase during the last finished frame.
+uint32_t profile_last_us(profile_phase_t phase);
+// Shown alongside the stats, the renderer reports the size it's drawing the scene at.
+void profile_set_resolution(uint16_t width, uint16_t height);
+
+void profile_toggle();
+bool profile_enabled();
+// Draws the stats with the CPU font, the RDP has to be idle. Returns the y below the text.
+int profile_draw_overlay(surface_t *disp, int x, int y);
+
+#endif
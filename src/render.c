@@ -1,11 +1,19 @@
 #include "render.h"
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include "_generated_models.h"
 #include "state.h"
 #include "primitive_models.h"
 #include "sprites.h"
 #include "debug.h"
-#include "libdragon_hax.h"
+#include "level_mesh.h"
+#include "text.h"
+#include "damage.h"
+#include "tmem.h"
+#include "profile.h"
+#include "trace.h"
+#include "vertex.h"
 
 #include "path.h"
 
@@ -21,35 +29,49 @@
 
 #define DEATH_X 170
 
+// Visible window in front of the camera, used to pick level chunks.
+// A point is in the window when its relative y is in range and
+// |camera.xx * relative_x * camera_w_factor_base / (camera.zy * relative_y)| < VISIBLE_MAX_SCREEN_X.
+#define VISIBLE_MIN_Y 4.f
+#define VISIBLE_MAX_Y 24.f
+#define VISIBLE_MAX_SCREEN_X 600.f
+
+// Projected bounding radius in pixels below which a model drops to its first lod.
+#define LOD_PIXEL_RADIUS 12.f
+
+// Snooper animation progress is rounded to this many steps
+// so snoopers on the same step can share one decoded mesh.
+// 4 steps between each of the 20 frames. A walking snooper moves one frame per tick,
+// so at 60fps every other draw lands halfway between two frames.
+#define SNOOPER_ANIMATION_KEYS 80
+
+// Anything closer than this to the camera plane is culled.
+// Must stay above MIN_FIXED_DEPTH so the fixed point clamp is never visible.
+#define CULL_NEAR_DEPTH 0.01f
+
 const float camera_z_factor = -0.04f;
 const float camera_w_factor_base = 0.16f;
-static float camera_wx_factor;
-static float camera_wy_factor;
 
+// Projected positions: x, y, z, 1/w
 float work_positions[4*MAX_MODEL_VERTICES] = {};
 float work_colors[3*MAX_MODEL_VERTICES] = {};
 
-float tri_vector_a[9] = {};
-float tri_vector_b[9] = {};
-float tri_vector_c[9] = {};
-
-static float camera_xx;
-static float camera_yy;
-static float camera_yz;
-static float camera_zy;
-static float camera_zz;
-
-static float light_direction_x = -0.57735f;
-static float light_direction_y = -0.57735f;
-static float light_direction_z = 0.57735f;
-
-static float directional_light_r = 0.85f;
-static float directional_light_g = 0.65f;
-static float directional_light_b = 0.45f;
+// One record per unique vertex, passed straight to rdpq_triangle: x, y, z, s, t, 1/w, r, g, b
+#define VERTEX_STRIDE 9
+float work_vertices[VERTEX_STRIDE*MAX_MODEL_VERTICES] = {};
+
+static vertex_camera_t camera = {
+	.light_direction = {-0.57735f, -0.57735f, 0.57735f},
+	.directional_r = 0.85f,
+	.directional_g = 0.65f,
+	.directional_b = 0.45f,
+	.ambient_r = 0.15f,
+	.ambient_g = 0.25f,
+	.ambient_b = 0.35f,
+};
 
-static float ambient_light_r = 0.15f;
-static float ambient_light_g = 0.25f;
-static float ambient_light_b = 0.35f;
+// The state between the last two simulation ticks, drawn instead of game_state's transforms.
+static state_snapshot_t view;
 
 static sprite_t *snooper_sprite;
 static sprite_t *spooker_sprite;
@@ -64,87 +86,82 @@ static sprite_t *cur_screen_sprite;
 
 static sprite_t light_surface_sprite;
 
-/*
-static long long fps_start_tick = 0;
-static int32_t fps_frame_count = 0;
-static int32_t fps = 0;
-*/
 
 const uint32_t SCREEN_WIDTH = 320;
 const uint32_t SCREEN_HEIGHT = 240;
 
 surface_t zbuffer;
-surface_t light_surface;
+// Lights are drawn into one surface while the other one, drawn last frame, is composited.
+// The full sync at the end of last frame guarantees the RDP is done writing it.
+static surface_t light_surfaces[2];
+static int light_draw_index;
 
 static uint32_t tri_count;
+static uint32_t object_drawn_count;
+static uint32_t object_culled_count;
+
+typedef enum {
+	CULL_OUTSIDE=0,
+	CULL_INTERSECT=1,
+	CULL_INSIDE=2,
+} cull_result_t;
+
+typedef enum {
+	CULL_PLANE_LEFT=0,
+	CULL_PLANE_RIGHT=1,
+	CULL_PLANE_TOP=2,
+	CULL_PLANE_BOTTOM=3,
+	CULL_PLANE_NEAR=4,
+	CULL_PLANE_COUNT=5,
+} cull_plane_t;
+
+// Length of each frustum plane normal, so plane distances can be compared with a radius.
+// Yaw only rotates about z, so these only change with the camera and framebuffer.
+static float cull_plane_norms[CULL_PLANE_COUNT];
+
+static void update_cull_planes() {
+	float x_y = camera.half_width * camera.zy;
+	float x_z = camera.half_width * camera.zz;
+	float x_x = camera.wx_factor * camera.xx;
+	cull_plane_norms[CULL_PLANE_LEFT] = sqrtf(x_x*x_x + x_y*x_y + x_z*x_z);
+	cull_plane_norms[CULL_PLANE_RIGHT] = cull_plane_norms[CULL_PLANE_LEFT];
+
+	float top_y = camera.half_height * camera.zy - camera.wy_factor * camera.yy;
+	float top_z = camera.half_height * camera.zz - camera.wy_factor * camera.yz;
+	cull_plane_norms[CULL_PLANE_TOP] = sqrtf(top_y*top_y + top_z*top_z);
+
+	float bottom_y = camera.half_height * camera.zy + camera.wy_factor * camera.yy;
+	float bottom_z = camera.half_height * camera.zz + camera.wy_factor * camera.yz;
+	cull_plane_norms[CULL_PLANE_BOTTOM] = sqrtf(bottom_y*bottom_y + bottom_z*bottom_z);
+
+	cull_plane_norms[CULL_PLANE_NEAR] = sqrtf(camera.zy*camera.zy + camera.zz*camera.zz);
+}
 
-static float half_framebuffer_width;
-static float half_framebuffer_height;
-
-static model_t *snooper_models[] = {
-	&snooper_000001_model,
-	&snooper_000002_model,
-	&snooper_000003_model,
-	&snooper_000004_model,
-	&snooper_000005_model,
-	&snooper_000006_model,
-	&snooper_000007_model,
-	&snooper_000008_model,
-	&snooper_000009_model,
-	&snooper_000010_model,
-	&snooper_000011_model,
-	&snooper_000012_model,
-	&snooper_000013_model,
-	&snooper_000014_model,
-	&snooper_000015_model,
-	&snooper_000016_model,
-	&snooper_000017_model,
-	&snooper_000018_model,
-	&snooper_000019_model,
-	&snooper_000020_model,
-};
-
-static model_t *snooper_feet_models[] = {
-	&snooper_000001_feet_model,
-	&snooper_000002_feet_model,
-	&snooper_000003_feet_model,
-	&snooper_000004_feet_model,
-	&snooper_000005_feet_model,
-	&snooper_000006_feet_model,
-	&snooper_000007_feet_model,
-	&snooper_000008_feet_model,
-	&snooper_000009_feet_model,
-	&snooper_000010_feet_model,
-	&snooper_000011_feet_model,
-	&snooper_000012_feet_model,
-	&snooper_000013_feet_model,
-	&snooper_000014_feet_model,
-	&snooper_000015_feet_model,
-	&snooper_000016_feet_model,
-	&snooper_000017_feet_model,
-	&snooper_000018_feet_model,
-	&snooper_000019_feet_model,
-	&snooper_000020_feet_model,
-};
+void update_framebuffer_size(surface_t *surf) {
+	camera.half_width = surf->width / 2;
+	camera.half_height = surf->height / 2;
 
+	camera.wx_factor = camera.half_width/160.f * camera_w_factor_base;
+	camera.wy_factor = camera.half_height/120.f * camera_w_factor_base;
 
-void update_framebuffer_size(surface_t *surf) {
-	half_framebuffer_width = surf->width / 2;
-	half_framebuffer_height = surf->height / 2;
+	update_cull_planes();
+}
 
-	camera_wx_factor = half_framebuffer_width/160.f * camera_w_factor_base;
-	camera_wy_factor = half_framebuffer_height/120.f * camera_w_factor_base;
+void set_camera_position(const vector3_t *position) {
+	view.camera_position = *position;
 }
 
 void set_camera_pitch(float camera_pitch) {
 	float sp = sinf(camera_pitch);
 	float cp = cosf(camera_pitch);
 
-	camera_xx = 100.f;
-	camera_yy = 100.f * cp;
-	camera_yz = 100.f * sp;
-	camera_zy = -camera_z_factor * sp;
-	camera_zz = camera_z_factor * cp;
+	camera.xx = 100.f;
+	camera.yy = 100.f * cp;
+	camera.yz = 100.f * sp;
+	camera.zy = -camera_z_factor * sp;
+	camera.zz = camera_z_factor * cp;
+
+	update_cull_planes();
 }
 
 
@@ -160,14 +177,89 @@ static float level_light_texcoords[] = {
 	63.f, 63.f,
 };
 
+// Instruction and end screens only redraw the parts of each buffer that changed.
+static damage_tracker_t screen_damage;
+static float screen_alpha;
+
+// In game, the letterbox bands only need clearing where a buffer still has old scene in them.
+static damage_tracker_t game_damage;
+
+static level_mesh_t level_mesh;
+
+static text_label_t level_name_label;
+static text_label_t level_goal_label;
+
+// Each bucket can hold every chunk in the level.
+static const model_t **level_buckets[LEVEL_LAYER_COUNT];
+static uint16_t *level_bucket_rows[LEVEL_LAYER_COUNT];
+static uint16_t level_bucket_lens[LEVEL_LAYER_COUNT];
+
+// Draws back to front by level row instead of using the z buffer, see render_scene_painter.
+static bool painter_mode = false;
+
+// Scissor for the scene, changing the color image resets it.
+static damage_rect_t scene_scissor;
+
+// Scene resolutions for dynamic resolution, native first.
+// The upscale draws the scene a slice at a time, and each slice has to fit in TMEM
+// and land on whole screen pixels.
+typedef struct {
+	uint16_t width;
+	uint16_t height;
+	uint8_t hslices;
+	uint8_t vslices;
+} resolution_level_t;
+
+static const resolution_level_t resolution_levels[] = {
+	{320, 240, 1, 1},
+	{256, 192, 4, 6},
+	{200, 150, 5, 5},
+	{160, 120, 5, 2},
+};
+
+// One displayed frame, render runs once per frame rather than once per simulation tick.
+#define FRAME_BUDGET_NTSC_US 16683
+#define FRAME_BUDGET_PAL_US 20000
+// Drop a level once the RDP has been this close to the budget for a few frames.
+#define RESOLUTION_DOWN_LOAD 0.9f
+#define RESOLUTION_DOWN_FRAMES 3
+// Go back up once the higher level is predicted to fit with room to spare for a while.
+#define RESOLUTION_UP_LOAD 0.75f
+#define RESOLUTION_UP_FRAMES 60
+
+static bool dynamic_resolution = true;
+static float frame_budget_us;
+static uint8_t resolution_level;
+static uint8_t resolution_over_frames;
+static uint8_t resolution_headroom_frames;
+
+// Holds the scene below native resolution, sized for the largest scaled level.
+static surface_t scene_buffer;
+static sprite_t scene_sprite;
+// The scene's color and z images for the current level.
+static surface_t scene_surface;
+static surface_t scene_zbuffer;
+
 typedef struct {
-	surface_t *surface;
-	float alpha;
-} surface_alpha_t;
+	uint16_t animation_key;
+	uint16_t row;
+	object_transform_t transform;
+	angle_t feet_rotation_z;
+} snooper_draw_t;
+
+// Sorted by animation_key, or by row then animation_key in painter mode.
+// Sized by the level's max_snooper_count.
+static snooper_draw_t *snooper_draws;
+static uint16_t snooper_draw_count;
 
-surface_alpha_t screen_surface_alphas[4];
+// Rects render_scene_painter clears z in, one per spooker and one per snooper.
+static damage_rect_t *z_rects;
 
 void renderer_init() {
+	uint32_t trace_start = TICKS_READ();
+
+	frame_budget_us = get_tv_type() == TV_TYPE_PAL ? FRAME_BUDGET_PAL_US : FRAME_BUDGET_NTSC_US;
+
     floor_sprite = sprite_load("rom:/ground.sprite");
     wall_sprite = sprite_load("rom:/wall.sprite");
     roof_sprite = sprite_load("rom:/roof.sprite");
@@ -180,7 +272,17 @@ void renderer_init() {
 	lose_sprite = sprite_load("rom:/lose.sprite");
 	cur_screen_sprite = NULL;
 
-	light_surface = surface_alloc(FMT_RGBA16, LIGHT_SURFACE_WIDTH, LIGHT_SURFACE_HEIGHT);
+	trace_record(TRACE_LOAD_ASSETS, trace_start, TICKS_READ());
+
+	for (int i = 0; i < ARRAY_LENGTH(light_surfaces); i++) {
+		light_surfaces[i] = surface_alloc(FMT_RGBA16, LIGHT_SURFACE_WIDTH, LIGHT_SURFACE_HEIGHT);
+
+		// The first frame composites a surface that was never drawn.
+		rdpq_set_color_image(&light_surfaces[i]);
+		rdpq_set_mode_fill(RGBA32(0x00, 0x00, 0x20, 0xff));
+		rdpq_fill_rectangle(0, 0, LIGHT_SURFACE_WIDTH, LIGHT_SURFACE_HEIGHT);
+	}
+	light_draw_index = 0;
 
 	light_surface_sprite.width = LIGHT_SURFACE_WIDTH;
 	light_surface_sprite.height = LIGHT_SURFACE_HEIGHT;
@@ -189,238 +291,394 @@ void renderer_init() {
 	light_surface_sprite.vslices = LIGHT_SPRITE_VSLICES;
 
 	zbuffer = surface_alloc(FMT_RGBA16, 320, 240);
+	scene_buffer = surface_alloc(FMT_RGBA16, resolution_levels[1].width, resolution_levels[1].height);
+	scene_sprite.flags = SPRITE_FLAGS_EXT | FMT_RGBA16;
 
 	set_camera_pitch(0.8f);
 	graphics_set_default_font();
 
+	primitive_models_init();
+
+	text_label_init(&level_name_label);
+	text_label_init(&level_goal_label);
+
 	line_model.positions_len = ARRAY_LENGTH(dynamic_quad_positions);
 	line_model.texcoords_len = floor_model.texcoords_len;
 	line_model.norms_len = floor_model.norms_len;
+	line_model.verts_len = floor_model.verts_len;
 	line_model.tris_len = floor_model.tris_len;
+	line_model.strips_len = floor_model.strips_len;
 
 	line_model.positions = dynamic_quad_positions;
 	line_model.texcoords = floor_model.texcoords;
 	line_model.norms = floor_model.norms;
+	line_model.verts = floor_model.verts;
 	line_model.tris = floor_model.tris;
+	line_model.strips = floor_model.strips;
 
 	level_light_model.positions_len = ARRAY_LENGTH(dynamic_quad_positions);
 	level_light_model.texcoords_len = ARRAY_LENGTH(level_light_texcoords);
 	level_light_model.norms_len = floor_model.norms_len;
+	level_light_model.verts_len = floor_model.verts_len;
 	level_light_model.tris_len = floor_model.tris_len;
+	level_light_model.strips_len = floor_model.strips_len;
 
 	level_light_model.positions = dynamic_quad_positions;
 	level_light_model.texcoords = level_light_texcoords;
 	level_light_model.norms = floor_model.norms;
+	level_light_model.verts = floor_model.verts;
 	level_light_model.tris = floor_model.tris;
-	
-	for (int i = 0; i < ARRAY_LENGTH(screen_surface_alphas); i++) {
-		screen_surface_alphas[i].surface = NULL;
-		screen_surface_alphas[i].alpha = 0.f;
+	level_light_model.strips = floor_model.strips;
+
+	damage_reset(&screen_damage, SCREEN_WIDTH, SCREEN_HEIGHT);
+	damage_reset(&game_damage, SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+static void setup_object(object_setup_t *setup, const vector3_t *position, float sin_yaw, float cos_yaw) {
+	vector3_t relative = {
+		position->x - view.camera_position.x,
+		position->y - view.camera_position.y,
+		position->z - view.camera_position.z,
+	};
+	vertex_setup_object(setup, &camera, &relative, sin_yaw, cos_yaw);
+}
+
+// The vertex stages for the pipeline this build uses.
+static inline void project_positions(const object_setup_t *setup, const model_t *model) {
+#if RENDER_FIXED_POINT
+	vertex_project_fixed(setup, &camera, model, work_positions);
+#else
+	vertex_project_float(setup, &camera, model, work_positions);
+#endif
+}
+
+static inline void shade_norms(const object_setup_t *setup, const model_t *model) {
+#if RENDER_FIXED_POINT
+	vertex_shade_fixed(setup, &camera, model, work_colors);
+#else
+	vertex_shade_float(setup, &camera, model, work_colors);
+#endif
+}
+
+// Call after changing a model's positions or norms at runtime.
+static inline void model_changed(model_t *model) {
+#if RENDER_FIXED_POINT
+	model_update_fixed(model);
+#endif
+}
+
+// Conservative sphere test against the screen edges and the near plane.
+// The far side is left to the level bucketing, nothing in the game is far enough to need it.
+static cull_result_t cull_sphere(const object_setup_t *setup, const model_t *model) {
+	float cx = model->bounds_center.x;
+	float cy = model->bounds_center.y;
+	float cz = model->bounds_center.z;
+	float radius = model->bounds_radius;
+
+	float x2 = setup->x[0]*cx + setup->x[1]*cy + setup->x[2]*cz + setup->x[3];
+	float y2 = setup->y[0]*cx + setup->y[1]*cy + setup->y[2]*cz + setup->y[3];
+	float z2 = setup->z[0]*cx + setup->z[1]*cy + setup->z[2]*cz + setup->z[3];
+
+	float distances[CULL_PLANE_COUNT] = {
+		camera.half_width*z2 + x2,
+		camera.half_width*z2 - x2,
+		camera.half_height*z2 - y2,
+		camera.half_height*z2 + y2,
+		z2 - CULL_NEAR_DEPTH,
+	};
+
+	cull_result_t result = CULL_INSIDE;
+	for (int i = 0; i < CULL_PLANE_COUNT; i++) {
+		float extent = radius * cull_plane_norms[i];
+		if (distances[i] < -extent) return CULL_OUTSIDE;
+		if (distances[i] < extent) result = CULL_INTERSECT;
+	}
+	return result;
+}
+
+
+// Triangle area test on projected vertex records.
+static inline bool is_front_facing(const float *a, const float *b, const float *c) {
+	float area = (
+		a[0] * b[1]
+		+ b[0] * c[1]
+		+ c[0] * a[1]
+		- a[0] * c[1]
+		- b[0] * a[1]
+		- c[0] * b[1]
+	);
+	return area > 0;
+}
+
+static inline bool crosses_near_plane(const float *a, const float *b, const float *c) {
+	return a[2] <= CULL_NEAR_DEPTH || b[2] <= CULL_NEAR_DEPTH || c[2] <= CULL_NEAR_DEPTH;
+}
+
+static inline void draw_triangle(const float *a, const float *b, const float *c, bool shaded, bool guarded) {
+	if (guarded && crosses_near_plane(a, b, c)) return;
+	if (!is_front_facing(a, b, c)) return;
+
+	rdpq_triangle(
+		TILE0, // tile
+		0, // mipmaps
+		0, // pos_offset
+		shaded ? 6 : -1, // shade_offset
+		3, // tex_offset
+		2, // depth_offset
+		a,
+		b,
+		c
+	);
+	tri_count++;
+}
+
+// Assembles the vertex records and submits the front facing triangles.
+// Guarded draws also drop triangles touching the near plane,
+// objects entirely inside the frustum don't need it.
+static void draw_triangles(const model_t *model, bool shaded, bool guarded) {
+	const float *in_texcoords = model->texcoords;
+	const uint16_t *in_verts = model->verts;
+	float *out_vert = work_vertices;
+	for (uint16_t i = 0; i < model->verts_len; i += 3) {
+		const float *pos = work_positions + 4*in_verts[i];
+		const float *texcoord = in_texcoords + 2*in_verts[i+1];
+
+		out_vert[0] = pos[0];
+		out_vert[1] = pos[1];
+		out_vert[2] = pos[2];
+		out_vert[3] = texcoord[0];
+		out_vert[4] = texcoord[1];
+		out_vert[5] = pos[3];
+
+		if (shaded) {
+			const float *color = work_colors + 3*in_verts[i+2];
+			out_vert[6] = color[0];
+			out_vert[7] = color[1];
+			out_vert[8] = color[2];
+		}
+		out_vert += VERTEX_STRIDE;
+	}
+
+	const uint16_t *in_tris = model->tris;
+	for (uint16_t i = 0; i < model->tris_len; i += 3) {
+		draw_triangle(
+			work_vertices + VERTEX_STRIDE*in_tris[i],
+			work_vertices + VERTEX_STRIDE*in_tris[i+1],
+			work_vertices + VERTEX_STRIDE*in_tris[i+2],
+			shaded,
+			guarded);
+	}
+
+	const uint16_t *in_strips = model->strips;
+	uint16_t i = 0;
+	while (i < model->strips_len) {
+		const float *a = work_vertices + VERTEX_STRIDE*in_strips[i];
+		const float *b = work_vertices + VERTEX_STRIDE*in_strips[i+1];
+		bool flip = false;
+		for (i += 2; i < model->strips_len && in_strips[i] != STRIP_RESTART; i++) {
+			const float *c = work_vertices + VERTEX_STRIDE*in_strips[i];
+			// Every other triangle in a strip has reversed winding.
+			if (flip) {
+				draw_triangle(b, a, c, shaded, guarded);
+			} else {
+				draw_triangle(a, b, c, shaded, guarded);
+			}
+			a = b;
+			b = c;
+			flip = !flip;
+		}
+		// Skip the restart.
+		i++;
 	}
 }
 
+// The work buffers are indexed straight from the model, so this stays on under NDEBUG.
+static void check_model_size(const model_t *model) {
+	if (model->positions_len > 3*MAX_MODEL_VERTICES
+			|| model->norms_len > 3*MAX_MODEL_VERTICES
+			|| model->verts_len > 3*MAX_MODEL_VERTICES) {
+		fprintf(stderr, "Model too big to draw, %u positions, %u norms, %u vertices, max %u.\n",
+			model->positions_len/3, model->norms_len/3, model->verts_len/3, MAX_MODEL_VERTICES);
+		abort();
+	}
+#if RENDER_FIXED_POINT
+	if (model->positions_len != 0 && model->fixed_positions == NULL) {
+		fprintf(stderr, "Model drawn before model_update_fixed.\n");
+		abort();
+	}
+#endif
+}
+
 void render_model_positioned(const vector3_t *position, const model_t *model) {
-	float relative_x = position->x - game_state.camera_position.x;
-	float relative_y = position->y - game_state.camera_position.y;
-	float relative_z = position->z - game_state.camera_position.z;
+	object_setup_t setup;
+	setup_object(&setup, position, 0.f, 1.f);
 
-	float *in_positions = model->positions;
-	float *out_pos = work_positions;
-	for (uint16_t i = 0; i < model->positions_len; i += 3) {
-		float in_x = in_positions[i];
-		float in_y = in_positions[i + 1];
-		float in_z = in_positions[i + 2];
-
-		// translate
-		in_x += relative_x;
-		in_y += relative_y;
-		in_z += relative_z;
-
-		float x2 = camera_xx*in_x;
-		float y2 = camera_yy*in_y + camera_yz*in_z;
-		float z2 = camera_zy*in_y + camera_zz*in_z;
-
-		x2 *= camera_wx_factor / z2;
-		y2 *= camera_wy_factor / z2;
-		x2 += half_framebuffer_width;
-		y2 = half_framebuffer_height - y2;
-
-		*(out_pos++) = x2;
-		*(out_pos++) = y2;
-		*(out_pos++) = z2;
+	cull_result_t cull = cull_sphere(&setup, model);
+	if (cull == CULL_OUTSIDE) {
+		object_culled_count++;
+		return;
 	}
+	object_drawn_count++;
+	check_model_size(model);
 
-	float *in_texcoords = model->texcoords;
-	uint16_t *in_tris = model->tris;
-	for (uint16_t i = 0; i < model->tris_len; i += 9) {
-		memcpy(tri_vector_a, work_positions+in_tris[i], 3*sizeof(float));
-		memcpy(tri_vector_b, work_positions+in_tris[i+3], 3*sizeof(float));
-		memcpy(tri_vector_c, work_positions+in_tris[i+6], 3*sizeof(float));
-
-		float area = (
-			tri_vector_a[0] * tri_vector_b[1]
-			+ tri_vector_b[0] * tri_vector_c[1]
-			+ tri_vector_c[0] * tri_vector_a[1]
-			- tri_vector_a[0] * tri_vector_c[1]
-			- tri_vector_b[0] * tri_vector_a[1]
-			- tri_vector_c[0] * tri_vector_b[1]
-		);
-		if (area <= 0) continue;
-
-		memcpy(tri_vector_a+3, in_texcoords+in_tris[i+1], 2*sizeof(float));
-		memcpy(tri_vector_b+3, in_texcoords+in_tris[i+4], 2*sizeof(float));
-		memcpy(tri_vector_c+3, in_texcoords+in_tris[i+7], 2*sizeof(float));
-
-		tri_vector_a[5] = 1.f / tri_vector_a[2];
-		tri_vector_b[5] = 1.f / tri_vector_b[2];
-		tri_vector_c[5] = 1.f / tri_vector_c[2];
-
-		rdpq_triangle(
-			TILE0, // tile
-			0, // mipmaps
-			0, // pos_offset
-			-1, // shade_offset
-			3, // tex_offset
-			2, // depth_offset
-			tri_vector_a,
-			tri_vector_b,
-			tri_vector_c
-		);
-		tri_count++;
+	project_positions(&setup, model);
+	draw_triangles(model, false, cull != CULL_INSIDE);
+}
+
+// Steps down the model's lod chain while its bounding sphere is small on screen.
+// Each step halves the radius needed to keep the current detail.
+static const model_t *select_lod(const object_setup_t *setup, const model_t *model) {
+	if (model->lod == NULL) return model;
+
+	float cx = model->bounds_center.x;
+	float cy = model->bounds_center.y;
+	float cz = model->bounds_center.z;
+	float z2 = setup->z[0]*cx + setup->z[1]*cy + setup->z[2]*cz + setup->z[3];
+	if (z2 <= CULL_NEAR_DEPTH) return model;
+
+	float scale = sqrtf(setup->y[0]*setup->y[0] + setup->y[1]*setup->y[1] + setup->y[2]*setup->y[2]);
+	float pixel_radius = model->bounds_radius * scale / z2;
+
+	float threshold = LOD_PIXEL_RADIUS;
+	while (model->lod != NULL && pixel_radius < threshold) {
+		model = model->lod;
+		threshold *= 0.5f;
 	}
+	return model;
 }
 
 void render_object_transformed_shaded(const object_transform_t *transform, const model_t *model) {
-	float sin_yaw = sinf(transform->rotation_z);
-	float cos_yaw = cosf(transform->rotation_z);
-
-	float relative_x = transform->position.x - game_state.camera_position.x;
-	float relative_y = transform->position.y - game_state.camera_position.y;
-	float relative_z = transform->position.z - game_state.camera_position.z;
+	object_setup_t setup;
+	setup_object(&setup, &transform->position, angle_sin(transform->rotation_z), angle_cos(transform->rotation_z));
 
-	float *in_positions = model->positions;
-	float *out_pos = work_positions;
-	for (uint16_t i = 0; i < model->positions_len; i += 3) {
-		float in_x = in_positions[i];
-		float in_y = in_positions[i + 1];
-		float in_z = in_positions[i + 2];
-
-		// Step 1: rotate
-		float x1 = cos_yaw*in_x + sin_yaw*in_y;
-		float y1 = cos_yaw*in_y - sin_yaw*in_x;
-		float z1 = in_z;
-
-		// Step 2: translate
-		x1 += relative_x;
-		y1 += relative_y;
-		z1 += relative_z;
-
-		float x2 = camera_xx*x1;
-		float y2 = camera_yy*y1 + camera_yz*z1;
-		float z2 = camera_zy*y1 + camera_zz*z1;
-
-		x2 *= camera_wx_factor / z2;
-		y2 *= camera_wy_factor / z2;
-		x2 += half_framebuffer_width;
-		y2 = half_framebuffer_height - y2;
-
-		// *(out_pos++) = w;
-		*(out_pos++) = x2;
-		*(out_pos++) = y2;
-		*(out_pos++) = z2;
+	cull_result_t cull = cull_sphere(&setup, model);
+	if (cull == CULL_OUTSIDE) {
+		object_culled_count++;
+		return;
 	}
+	object_drawn_count++;
 
-	float light_vec_x = light_direction_x * cos_yaw - light_direction_y * sin_yaw;
-	float light_vec_y = light_direction_x * sin_yaw + light_direction_y * cos_yaw;
+	model = select_lod(&setup, model);
+	check_model_size(model);
 
-	float *in_norms = model->norms;
-	for (uint16_t i = 0; i < model->norms_len; i += 3) {
-		float norm_x = in_norms[i];
-		float norm_y = in_norms[i+1];
-		float norm_z = in_norms[i+2];
+	project_positions(&setup, model);
+	shade_norms(&setup, model);
+	draw_triangles(model, true, cull != CULL_INSIDE);
+}
 
-		float brightness = (
-			  light_vec_x * norm_x
-			+ light_vec_y * norm_y
-			+ light_direction_z * norm_z
-		);
-		if (brightness < 0.0f) {
-			brightness = 0.0f;
-		}
+void model_compute_bounds(model_t *model) {
+	if (model->positions_len == 0) {
+		model->bounds_center.x = 0.f;
+		model->bounds_center.y = 0.f;
+		model->bounds_center.z = 0.f;
+		model->bounds_radius = 0.f;
+		return;
+	}
 
-		// Skip normal/color for now.
-		work_colors[i] = ambient_light_r + brightness * directional_light_r;
-		work_colors[i+1] = ambient_light_g + brightness * directional_light_g;
-		work_colors[i+2] = ambient_light_b + brightness * directional_light_b;
+	float min[3];
+	float max[3];
+	for (int j = 0; j < 3; j++) {
+		min[j] = model->positions[j];
+		max[j] = model->positions[j];
+	}
+	for (uint16_t i = 3; i < model->positions_len; i += 3) {
+		for (int j = 0; j < 3; j++) {
+			float v = model->positions[i + j];
+			if (v < min[j]) min[j] = v;
+			if (v > max[j]) max[j] = v;
+		}
 	}
 
-	float *in_texcoords = model->texcoords;
-	uint16_t *in_tris = model->tris;
-	for (uint16_t i = 0; i < model->tris_len; i += 9) {
-		memcpy(tri_vector_a, work_positions+in_tris[i], 3*sizeof(float));
-		memcpy(tri_vector_c, work_positions+in_tris[i+6], 3*sizeof(float));
-		memcpy(tri_vector_b, work_positions+in_tris[i+3], 3*sizeof(float));
-
-		float area = (
-			tri_vector_a[0] * tri_vector_b[1]
-			+ tri_vector_b[0] * tri_vector_c[1]
-			+ tri_vector_c[0] * tri_vector_a[1]
-			- tri_vector_a[0] * tri_vector_c[1]
-			- tri_vector_b[0] * tri_vector_a[1]
-			- tri_vector_c[0] * tri_vector_b[1]
-		);
-		if (area <= 0) continue;
-
-		memcpy(tri_vector_a+3, in_texcoords+in_tris[i+1], 2*sizeof(float));
-		memcpy(tri_vector_b+3, in_texcoords+in_tris[i+4], 2*sizeof(float));
-		memcpy(tri_vector_c+3, in_texcoords+in_tris[i+7], 2*sizeof(float));
-
-		memcpy(tri_vector_a+6, work_colors+in_tris[i+2], 3*sizeof(float));
-		memcpy(tri_vector_b+6, work_colors+in_tris[i+5], 3*sizeof(float));
-		memcpy(tri_vector_c+6, work_colors+in_tris[i+8], 3*sizeof(float));
-
-		tri_vector_a[5] = 1.f / tri_vector_a[2];
-		tri_vector_b[5] = 1.f / tri_vector_b[2];
-		tri_vector_c[5] = 1.f / tri_vector_c[2];
-
-		rdpq_triangle(
-			TILE0, // tile
-			0, // mipmaps
-			0, // pos_offset
-			6, // shade_offset
-			3, // tex_offset
-			2, // depth_offset
-			tri_vector_a,
-			tri_vector_b,
-			tri_vector_c
-		);
-		tri_count++;
+	// Center of the box, radius out to the farthest position.
+	float cx = 0.5f * (min[0] + max[0]);
+	float cy = 0.5f * (min[1] + max[1]);
+	float cz = 0.5f * (min[2] + max[2]);
+	float radius2 = 0.f;
+	for (uint16_t i = 0; i < model->positions_len; i += 3) {
+		float dx = model->positions[i] - cx;
+		float dy = model->positions[i + 1] - cy;
+		float dz = model->positions[i + 2] - cz;
+		float d2 = dx*dx + dy*dy + dz*dz;
+		if (d2 > radius2) radius2 = d2;
 	}
+
+	model->bounds_center.x = cx;
+	model->bounds_center.y = cy;
+	model->bounds_center.z = cz;
+	model->bounds_radius = sqrtf(radius2);
 }
 
-void clear_z_buffer() {
-	rdpq_set_color_image(&zbuffer);
-	rdpq_set_mode_fill(RGBA32(0xff, 0xff, 0xff, 0xff));
-	rdpq_fill_rectangle(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+static int16_t clamp_to_screen(float v, float max) {
+	if (v < 0.f) return 0;
+	if (v > max) return (int16_t)max;
+	return (int16_t)v;
 }
 
-static bool should_render(float x, float y) {
-	float relative_y = y - game_state.camera_position.y;
-	if (relative_y <= 4.f || relative_y >= 24.f) return false;
-	
-	float screen_z = camera_zy*relative_y;
-	float screen_x = camera_xx*(x-game_state.camera_position.x)*camera_w_factor_base/screen_z;
+// Conservative screen rect around the bounding sphere of a model.
+static void object_screen_rect(const object_transform_t *transform, const model_t *model, damage_rect_t *rect) {
+	object_setup_t setup;
+	setup_object(&setup, &transform->position, angle_sin(transform->rotation_z), angle_cos(transform->rotation_z));
+
+	float cx = model->bounds_center.x;
+	float cy = model->bounds_center.y;
+	float cz = model->bounds_center.z;
+	float radius = model->bounds_radius;
+
+	float x2 = setup.x[0]*cx + setup.x[1]*cy + setup.x[2]*cz + setup.x[3];
+	float y2 = setup.y[0]*cx + setup.y[1]*cy + setup.y[2]*cz + setup.y[3];
+	float z2 = setup.z[0]*cx + setup.z[1]*cy + setup.z[2]*cz + setup.z[3];
+
+	float rx = radius * sqrtf(setup.x[0]*setup.x[0] + setup.x[1]*setup.x[1] + setup.x[2]*setup.x[2]);
+	float ry = radius * sqrtf(setup.y[0]*setup.y[0] + setup.y[1]*setup.y[1] + setup.y[2]*setup.y[2]);
+	float rz = radius * sqrtf(setup.z[0]*setup.z[0] + setup.z[1]*setup.z[1] + setup.z[2]*setup.z[2]);
+
+	float width = 2.f*camera.half_width;
+	float height = 2.f*camera.half_height;
+
+	float near_z = z2 - rz;
+	float far_z = z2 + rz;
+	if (near_z <= CULL_NEAR_DEPTH) {
+		rect->x0 = 0;
+		rect->y0 = 0;
+		rect->x1 = (int16_t)width;
+		rect->y1 = (int16_t)height;
+		return;
+	}
 
-	return (screen_x > -600.f && screen_x < 600.f);
-}
+	// x/z and y/z are monotonic over the box around the sphere, so its corners bound them.
+	float min_x = fminf((x2 - rx)/near_z, (x2 - rx)/far_z);
+	float max_x = fmaxf((x2 + rx)/near_z, (x2 + rx)/far_z);
+	float min_y = fminf((y2 - ry)/near_z, (y2 - ry)/far_z);
+	float max_y = fmaxf((y2 + ry)/near_z, (y2 + ry)/far_z);
 
+	rect->x0 = clamp_to_screen(floorf(camera.half_width + min_x) - 1.f, width);
+	rect->x1 = clamp_to_screen(ceilf(camera.half_width + max_x) + 1.f, width);
+	rect->y0 = clamp_to_screen(floorf(camera.half_height - max_y) - 1.f, height);
+	rect->y1 = clamp_to_screen(ceilf(camera.half_height - min_y) + 1.f, height);
+}
 
+// Resets the z buffer inside rects. Switching the color image resets the scissor so it's put back.
+static void clear_z_rects(surface_t *target, const damage_rect_t *rects, int count) {
+	if (count == 0) return;
 
-static void render_line(vector2_t src, vector2_t dest, float width) {
-	if (!(should_render(src.x, src.y) || should_render(dest.x, dest.y))) {
-		return;
+	rdpq_set_color_image(&scene_zbuffer);
+	rdpq_set_mode_fill(RGBA32(0xff, 0xff, 0xff, 0xff));
+	for (int i = 0; i < count; i++) {
+		if (rects[i].x0 >= rects[i].x1 || rects[i].y0 >= rects[i].y1) continue;
+		rdpq_fill_rectangle(rects[i].x0, rects[i].y0, rects[i].x1, rects[i].y1);
 	}
 
+	rdpq_set_color_image(target);
+	rdpq_set_scissor(scene_scissor.x0, scene_scissor.y0, scene_scissor.x1, scene_scissor.y1);
+}
+
+void clear_z_buffer() {
+	rdpq_set_color_image(&zbuffer);
+	rdpq_set_mode_fill(RGBA32(0xff, 0xff, 0xff, 0xff));
+	rdpq_fill_rectangle(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+static void render_line(vector2_t src, vector2_t dest, float width) {
 	float dx = dest.x - src.x;
 	float dy = dest.y - src.y;
 	float dist = sqrtf(dx*dx + dy*dy);
@@ -439,6 +697,8 @@ static void render_line(vector2_t src, vector2_t dest, float width) {
 
 	line_model.positions[9] = dest.x + offset_x;
 	line_model.positions[10] = dest.y + offset_y;
+	model_compute_bounds(&line_model);
+	model_changed(&line_model);
 
 	vector3_t pos = {0.f, 0.f, 0.f};
 	render_model_positioned(&pos, &line_model);
@@ -477,49 +737,412 @@ void render_graph(const path_graph_t *graph, int16_t closest_node) {
 	}
 }
 
-void render_wall(uint8_t d, vector3_t *position) {
-	if (d & 2) {
-		render_model_positioned(position, &wall_model);
+void render_load_level(const level_t *level, arena_t *arena) {
+	level_mesh_build(&level_mesh, level, arena);
+
+	int chunk_count = level_mesh.chunk_columns*level_mesh.chunk_rows;
+	for (int layer = 0; layer < LEVEL_LAYER_COUNT; layer++) {
+		level_buckets[layer] = ARENA_ALLOC_ARRAY(arena, const model_t *, chunk_count);
+		level_bucket_rows[layer] = ARENA_ALLOC_ARRAY(arena, uint16_t, chunk_count);
+		level_bucket_lens[layer] = 0;
 	}
-	if (d & 4) {
-		render_model_positioned(position, &wall_left_model);
+
+	state_snapshot_alloc(&view, level, arena);
+
+	snooper_draws = ARENA_ALLOC_ARRAY(arena, snooper_draw_t, level->max_snooper_count);
+	snooper_draw_count = 0;
+
+	z_rects = ARENA_ALLOC_ARRAY(arena, damage_rect_t, level->max_snooper_count + level->max_spooker_count);
+
+	text_label_set(&level_name_label, level->name);
+
+	char goal_str[TEXT_LABEL_MAX_LENGTH + 1];
+	snprintf(goal_str, sizeof(goal_str), "Spook %d Snoopers", level->score_target);
+	text_label_set(&level_goal_label, goal_str);
+}
+
+size_t render_level_arena_size(const level_t *level) {
+	int chunk_count = level_mesh_chunk_count(level);
+	return level_mesh_arena_size(level)
+		+ LEVEL_LAYER_COUNT*(ARENA_ARRAY_SIZE(const model_t *, chunk_count) + ARENA_ARRAY_SIZE(uint16_t, chunk_count))
+		+ state_snapshot_arena_size(level)
+		+ ARENA_ARRAY_SIZE(snooper_draw_t, level->max_snooper_count)
+		+ ARENA_ARRAY_SIZE(damage_rect_t, level->max_snooper_count + level->max_spooker_count);
+}
+
+// Collects the visible chunk layers into per-texture buckets.
+// Only the rows and columns inside the camera window are visited.
+static void bucket_visible_level() {
+	for (int layer = 0; layer < LEVEL_LAYER_COUNT; layer++) {
+		level_bucket_lens[layer] = 0;
+	}
+
+	float camera_x = view.camera_position.x;
+	float camera_y = view.camera_position.y;
+
+	// Row y is (height - 1 - 2*row), visible while VISIBLE_MIN_Y < y - camera_y < VISIBLE_MAX_Y.
+	float top = game_state.level->height - 1 - camera_y;
+	int min_row = (int)floorf(0.5f*(top - VISIBLE_MAX_Y)) + 1;
+	int max_row = (int)ceilf(0.5f*(top - VISIBLE_MIN_Y)) - 1;
+	if (min_row < 0) min_row = 0;
+	if (max_row >= level_mesh.chunk_rows) max_row = level_mesh.chunk_rows - 1;
+
+	float level_left = -game_state.level->width + 1;
+	float chunk_pitch = 2.f*LEVEL_CHUNK_WIDTH;
+
+	for (int row = min_row; row <= max_row; row++) {
+		const level_chunk_t *row_chunks = &level_mesh.chunks[row*level_mesh.chunk_columns];
+
+		// The window's x test, solved for x.
+		float screen_z = camera.zy*(row_chunks->y - camera_y);
+		float half_extent = VISIBLE_MAX_SCREEN_X*screen_z/(camera.xx*camera_w_factor_base);
+		float min_x = camera_x - half_extent;
+		float max_x = camera_x + half_extent;
+
+		int column = (int)floorf((min_x - level_left) / chunk_pitch);
+		if (column < 0) column = 0;
+
+		for (; column < level_mesh.chunk_columns; column++) {
+			const level_chunk_t *chunk = &row_chunks[column];
+			if (chunk->min_x >= max_x) break;
+			if (chunk->max_x <= min_x) continue;
+
+			for (int layer = 0; layer < LEVEL_LAYER_COUNT; layer++) {
+				const model_t *model = &chunk->layers[layer];
+				if (model->verts_len == 0) continue;
+				level_bucket_rows[layer][level_bucket_lens[layer]] = row;
+				level_buckets[layer][level_bucket_lens[layer]++] = model;
+			}
+		}
 	}
-	if (d & 8) {
-		render_model_positioned(position, &wall_right_model);
+}
+
+static void render_level_bucket_range(level_layer_t layer, uint16_t begin, uint16_t end) {
+	// Chunk geometry is already in world space.
+	vector3_t origin = {0.f, 0.f, 0.f};
+
+	for (uint16_t i = begin; i < end; i++) {
+		render_model_positioned(&origin, level_buckets[layer][i]);
 	}
-	if (d & 0x20) {
-		render_model_positioned(position, &fall_model);
+}
+
+static void render_level_bucket(level_layer_t layer) {
+	render_level_bucket_range(layer, 0, level_bucket_lens[layer]);
+}
+
+// Level row containing world y, clamped to the level.
+static uint16_t level_row_at(float y) {
+	int row = (int)floorf(0.5f*(game_state.level->height - y));
+	if (row < 0) row = 0;
+	if (row >= level_mesh.chunk_rows) row = level_mesh.chunk_rows - 1;
+	return row;
+}
+
+static void collect_snooper_draws() {
+	snooper_draw_count = 0;
+	const snooper_pool_t *snoopers = &game_state.snoopers;
+	for (int i = 0; i < snoopers->slot_limit; i++) {
+		if (snoopers->status[i] == SNOOPER_STATUS_DEAD) continue;
+
+		snooper_draw_t draw;
+		// Rounded, and the last step wraps around to the first like the progress does.
+		draw.animation_key = (uint16_t)(view.snooper_animation_progress[i] * SNOOPER_ANIMATION_KEYS + 0.5f);
+		if (draw.animation_key >= SNOOPER_ANIMATION_KEYS) draw.animation_key = 0;
+
+		draw.transform.position.x = view.snooper_position[i].x;
+		draw.transform.position.y = view.snooper_position[i].y;
+		draw.transform.rotation_z = view.snooper_head_rotation_z[i];
+		draw.feet_rotation_z = view.snooper_feet_rotation_z[i];
+
+		if (snoopers->status[i] == SNOOPER_STATUS_DYING) {
+			float progress = snoopers->freeze_timer[i] / (float)SNOOPER_DIE_DURATION;
+			draw.transform.position.z = -10.f * progress * progress;
+		} else if (snoopers->status[i] == SNOOPER_STATUS_SPOOKED) {
+			float t = snoopers->spooked_timer[i] / 8.f;
+			if (t > 1.0f) t = 1.0f;
+			draw.transform.position.z = 4.f * t * (1.f - t);
+		} else {
+			draw.transform.position.z = 0.f;
+		}
+
+		// Painter mode needs them back to front, rows are sorted far to near.
+		draw.row = painter_mode ? level_row_at(view.snooper_position[i].y) : 0;
+
+		// Insertion sort, there are only a few snoopers.
+		int j = snooper_draw_count++;
+		for (; j > 0; j--) {
+			const snooper_draw_t *prev = &snooper_draws[j-1];
+			if (prev->row < draw.row) break;
+			if (prev->row == draw.row && prev->animation_key <= draw.animation_key) break;
+			snooper_draws[j] = *prev;
+		}
+		snooper_draws[j] = draw;
 	}
 }
 
-void render_roof(uint8_t d, vector3_t *position) {
-	if (d & 16) {
-		render_model_positioned(position, &roof_model);
+// Draws one part for the snoopers in [begin, end), decoding each animation step once.
+static void render_snooper_pass(const model_animation_t *animation, bool feet, uint16_t begin, uint16_t end) {
+	int decoded_key = -1;
+	for (uint16_t i = begin; i < end; i++) {
+		const snooper_draw_t *draw = &snooper_draws[i];
+		if (draw->animation_key != decoded_key) {
+#if RENDER_FIXED_POINT
+			model_animation_decode_fixed(animation, draw->animation_key / (float)SNOOPER_ANIMATION_KEYS);
+#else
+			model_animation_decode(animation, draw->animation_key / (float)SNOOPER_ANIMATION_KEYS);
+#endif
+			decoded_key = draw->animation_key;
+		}
+
+		object_transform_t transform = draw->transform;
+		if (feet) {
+			transform.rotation_z = draw->feet_rotation_z;
+		}
+		render_object_transformed_shaded(&transform, animation->model);
 	}
 }
 
-void render_floor(uint8_t d, vector3_t *position) {
-	if (d & 1) {
-		render_model_positioned(position, &floor_model);
+static void set_wall_mode(bool compare_z, bool write_z) {
+	rdpq_set_mode_standard();
+	rdpq_mode_persp(true);
+	rdpq_change_other_modes_raw(SOM_SAMPLE_MASK, SOM_SAMPLE_BILINEAR);
+	rdpq_mode_zbuf(compare_z, write_z);
+	// rdpq_change_other_modes_raw(SOM_AA_ENABLE, SOM_AA_ENABLE);
+	rdpq_mode_mipmap(MIPMAP_NONE, 0);
+
+	rdpq_mode_combiner(RDPQ_COMBINER_TEX_FLAT);
+
+	rdpq_set_prim_color(RGBA32(0x20, 0x20, 0x20, 0xff));
+}
+
+static void set_entity_mode() {
+	rdpq_set_mode_standard();
+	rdpq_set_other_modes_raw(SOM_TEXTURE_PERSP);
+	rdpq_change_other_modes_raw(SOM_SAMPLE_MASK, SOM_SAMPLE_BILINEAR);
+	rdpq_change_other_modes_raw(SOM_TF_MASK, SOM_TF0_RGB);
+	rdpq_mode_mipmap(MIPMAP_NONE, 0);
+	rdpq_mode_zbuf(true, true);
+	rdpq_mode_combiner(RDPQ_COMBINER_TEX_SHADE);
+	rdpq_mode_blender(RDPQ_BLENDER((IN_RGB, IN_ALPHA, IN_RGB, INV_MUX_ALPHA)));
+}
+
+static bool is_spooker_blinking(const spooker_state_t *spooker) {
+	return spooker->knockback_timer < SPOOKER_KNOCKBACK_THRESHOLD && spooker->knockback_timer % 4 >= 2;
+}
+
+static void render_spookers() {
+	// Render spooker outlines
+	rdpq_set_mode_standard();
+	rdpq_set_other_modes_raw(SOM_TEXTURE_PERSP);
+	rdpq_change_other_modes_raw(SOM_SAMPLE_MASK, SOM_SAMPLE_BILINEAR);
+	rdpq_change_other_modes_raw(SOM_TF_MASK, SOM_TF0_RGB);
+	rdpq_mode_mipmap(MIPMAP_NONE, 0);
+	rdpq_mode_zbuf(false, false);
+	rdpq_mode_combiner(RDPQ_COMBINER_FLAT);
+	rdpq_mode_blender(RDPQ_BLENDER((IN_RGB, IN_ALPHA, MEMORY_RGB, INV_MUX_ALPHA)));
+	rdpq_set_prim_color(RGBA32(0, 0x0, 0x0, 0xc0));
+	for (int i = 0; i < game_state.spooker_count; i++) {
+		spooker_state_t *spooker = &game_state.spookers[i];
+		if (is_spooker_blinking(spooker)) continue;
+		render_object_transformed_shaded(&view.spookers[i], &spooker_model);
 	}
+
+	// Render spookers
+	rdpq_mode_zbuf(true, true);
+	rdpq_mode_combiner(RDPQ_COMBINER_TEX_SHADE);
+	rdpq_mode_blender(RDPQ_BLENDER((IN_RGB, IN_ALPHA, IN_RGB, INV_MUX_ALPHA)));
+	tmem_load_sprite(spooker_sprite);
+	for (int i = 0; i < game_state.spooker_count; i++) {
+		spooker_state_t *spooker = &game_state.spookers[i];
+		if (is_spooker_blinking(spooker)) continue;
+		render_object_transformed_shaded(&view.spookers[i], &spooker_model);
+	}
+}
+
+// Called inside the level profile phase, which it ends before the entities.
+static void render_scene_depth() {
+	// Render walls
+	set_wall_mode(true, true);
+
+	tmem_load_sprite(wall_sprite);
+	render_level_bucket(LEVEL_LAYER_WALL);
+
+	tmem_load_sprite(roof_sprite);
+	render_level_bucket(LEVEL_LAYER_ROOF);
+
+	// Render paths
+	// render_graph(game_state.level->path_graph, closest_node);
+
+	profile_end(PROFILE_LEVEL);
+	profile_begin(PROFILE_ENTITIES);
+
+	render_spookers();
+
+	// Render snoopers
+	collect_snooper_draws();
+	tmem_load_sprite(snooper_sprite);
+	render_snooper_pass(&snooper_animation, false, 0, snooper_draw_count);
+	render_snooper_pass(&snooper_feet_animation, true, 0, snooper_draw_count);
+
+	profile_end(PROFILE_ENTITIES);
 }
 
-void foreach_level_element(void (func)(uint8_t, vector3_t*)) {
-	vector3_t level_position;
-	level_position.z = 0.f;
-	level_position.y = game_state.level->height - 1;
-	const uint8_t *data = game_state.level->data;
-	for (uint16_t y = 0; y < game_state.level->height; y++) {
-		level_position.x = -game_state.level->width + 1;
-		for (uint16_t x = 0; x < game_state.level->width; x++) {
-			uint8_t d = *(data++);
-			if (should_render(level_position.x, level_position.y)) {
-				func(d, &level_position);
+// Walls, roofs and snoopers are drawn a level row at a time from far to near without the z buffer,
+// so it never needs a full clear. Z is only used inside small rects, all cleared before any walls:
+// - the snoopers, so a snooper's own triangles sort against each other.
+// - the spookers, which are still drawn last so their outline shows through walls.
+//   Walls from the spooker's row forward write z for them to test against.
+// Nothing is cleared after the walls start, so no clear can drop wall z a spooker needs.
+// Like render_scene_depth, this ends the level profile phase.
+static void render_scene_painter(surface_t *target) {
+	collect_snooper_draws();
+
+	damage_rect_t *rects = z_rects;
+	int rect_count = 0;
+
+	uint16_t spooker_row = level_mesh.chunk_rows;
+	for (int i = 0; i < game_state.spooker_count; i++) {
+		const spooker_state_t *spooker = &game_state.spookers[i];
+		if (is_spooker_blinking(spooker)) continue;
+
+		object_screen_rect(&view.spookers[i], &spooker_model, &rects[rect_count++]);
+		uint16_t row = level_row_at(view.spookers[i].position.y);
+		if (row < spooker_row) spooker_row = row;
+	}
+	for (uint16_t i = 0; i < snooper_draw_count; i++) {
+		damage_rect_t feet_rect;
+		damage_rect_t *rect = &rects[rect_count++];
+		object_screen_rect(&snooper_draws[i].transform, &snooper_model, rect);
+		object_screen_rect(&snooper_draws[i].transform, &snooper_feet_model, &feet_rect);
+		if (feet_rect.x0 < rect->x0) rect->x0 = feet_rect.x0;
+		if (feet_rect.y0 < rect->y0) rect->y0 = feet_rect.y0;
+		if (feet_rect.x1 > rect->x1) rect->x1 = feet_rect.x1;
+		if (feet_rect.y1 > rect->y1) rect->y1 = feet_rect.y1;
+	}
+	clear_z_rects(target, rects, rect_count);
+
+	uint16_t wall_index = 0;
+	uint16_t roof_index = 0;
+	uint16_t snooper_index = 0;
+	for (uint16_t row = 0; row < level_mesh.chunk_rows; row++) {
+		uint16_t wall_end = wall_index;
+		while (wall_end < level_bucket_lens[LEVEL_LAYER_WALL] && level_bucket_rows[LEVEL_LAYER_WALL][wall_end] == row) wall_end++;
+		uint16_t roof_end = roof_index;
+		while (roof_end < level_bucket_lens[LEVEL_LAYER_ROOF] && level_bucket_rows[LEVEL_LAYER_ROOF][roof_end] == row) roof_end++;
+		uint16_t snooper_end = snooper_index;
+		while (snooper_end < snooper_draw_count && snooper_draws[snooper_end].row == row) snooper_end++;
+
+		if (wall_end != wall_index || roof_end != roof_index) {
+			set_wall_mode(false, row >= spooker_row);
+
+			if (wall_end != wall_index) {
+				tmem_load_sprite(wall_sprite);
+				render_level_bucket_range(LEVEL_LAYER_WALL, wall_index, wall_end);
+			}
+			if (roof_end != roof_index) {
+				tmem_load_sprite(roof_sprite);
+				render_level_bucket_range(LEVEL_LAYER_ROOF, roof_index, roof_end);
 			}
-			level_position.x += 2.f;
 		}
-		level_position.y -= 2.f;
+
+		if (snooper_end != snooper_index) {
+			profile_end(PROFILE_LEVEL);
+			profile_begin(PROFILE_ENTITIES);
+
+			set_entity_mode();
+			tmem_load_sprite(snooper_sprite);
+			render_snooper_pass(&snooper_animation, false, snooper_index, snooper_end);
+			render_snooper_pass(&snooper_feet_animation, true, snooper_index, snooper_end);
+
+			profile_end(PROFILE_ENTITIES);
+			profile_begin(PROFILE_LEVEL);
+		}
+
+		wall_index = wall_end;
+		roof_index = roof_end;
+		snooper_index = snooper_end;
 	}
+
+	profile_end(PROFILE_LEVEL);
+	profile_begin(PROFILE_ENTITIES);
+	render_spookers();
+	profile_end(PROFILE_ENTITIES);
+}
+
+// Picks the scene resolution from how busy the RDP was last frame.
+static void update_resolution_level() {
+	if (!dynamic_resolution) {
+		resolution_level = 0;
+		resolution_over_frames = 0;
+		resolution_headroom_frames = 0;
+		return;
+	}
+
+	// Fill rate is most of the RDP's work, so scale by the pixel count to predict the next level up.
+	float rdp_us = profile_last_us(PROFILE_RDP);
+	float up_us = rdp_us;
+	if (resolution_level > 0) {
+		const resolution_level_t *current = &resolution_levels[resolution_level];
+		const resolution_level_t *up = &resolution_levels[resolution_level - 1];
+		up_us *= (float)(up->width * up->height) / (current->width * current->height);
+	}
+
+	if (rdp_us > RESOLUTION_DOWN_LOAD * frame_budget_us) {
+		resolution_over_frames++;
+		resolution_headroom_frames = 0;
+	} else if (resolution_level > 0 && up_us < RESOLUTION_UP_LOAD * frame_budget_us) {
+		resolution_headroom_frames++;
+		resolution_over_frames = 0;
+	} else {
+		resolution_over_frames = 0;
+		resolution_headroom_frames = 0;
+	}
+
+	if (resolution_over_frames >= RESOLUTION_DOWN_FRAMES && resolution_level + 1 < ARRAY_LENGTH(resolution_levels)) {
+		resolution_level++;
+		resolution_over_frames = 0;
+	} else if (resolution_headroom_frames >= RESOLUTION_UP_FRAMES) {
+		resolution_level--;
+		resolution_headroom_frames = 0;
+	}
+}
+
+// Draws rows y0 to y1 of the scaled scene over the same part of the display.
+static void upscale_scene(surface_t *disp, int y0, int y1) {
+	const resolution_level_t *resolution = &resolution_levels[resolution_level];
+	float scale_x = (float)SCREEN_WIDTH / resolution->width;
+	float scale_y = (float)SCREEN_HEIGHT / resolution->height;
+
+	rdpq_set_color_image(disp);
+	rdpq_set_scissor(0, y0, SCREEN_WIDTH, y1);
+
+	// Point sampled, bilinear would show seams between the slices.
+	rdpq_set_mode_standard();
+	rdpq_change_other_modes_raw(SOM_SAMPLE_MASK, SOM_SAMPLE_POINT);
+	rdpq_mode_combiner(RDPQ_COMBINER_TEX);
+
+	int slice_width = resolution->width / resolution->hslices;
+	int slice_height = resolution->height / resolution->vslices;
+	for (int row = 0; row < resolution->vslices; row++) {
+		float t = row * slice_height;
+		float screen_y0 = t * scale_y;
+		float screen_y1 = (t + slice_height) * scale_y;
+		if (screen_y1 <= y0 || screen_y0 >= y1) continue;
+
+		for (int column = 0; column < resolution->hslices; column++) {
+			float s = column * slice_width;
+			tmem_load(&scene_sprite, scene_surface.buffer, row * resolution->hslices + column);
+			rdpq_texture_rectangle(0,
+				s * scale_x, screen_y0,
+				(s + slice_width) * scale_x, screen_y1,
+				s, t, 1.f / scale_x, 1.f / scale_y);
+		}
+	}
+}
+
+void render_toggle_dynamic_resolution() {
+	dynamic_resolution = !dynamic_resolution;
+	debugf("dynamic resolution %s\n", dynamic_resolution ? "on" : "off");
 }
 
 void render_digit(int x, int y, int digit) {
@@ -528,12 +1151,111 @@ void render_digit(int x, int y, int digit) {
 	rdpq_texture_rectangle(0, x, y, x + 8, y + 16, s, t, 1.f, 1.f);
 }
 
-void load_screen(const char *path) {
-	for (int i = 0; i < ARRAY_LENGTH(screen_surface_alphas); i++) {
-		screen_surface_alphas[i].surface = NULL;
-		screen_surface_alphas[i].alpha = 0.f;
+// A recorded command block, recorded again only when its key changes.
+// The RSP can still be running the old block from an earlier frame, so it's
+// only freed once the syncpoint queued after its last run has been reached.
+typedef struct {
+	rspq_block_t *block;
+	uint64_t key;
+	rspq_block_t *retired;
+	rspq_syncpoint_t retired_sync;
+} cached_block_t;
+
+static cached_block_t hud_block;
+static cached_block_t end_overlay_block;
+
+static void cached_block_run(cached_block_t *cached, uint64_t key, void (*record)()) {
+	if (cached->retired != NULL && rspq_syncpoint_check(cached->retired_sync)) {
+		rspq_block_free(cached->retired);
+		cached->retired = NULL;
+	}
+
+	if (cached->block == NULL || cached->key != key) {
+		if (cached->block != NULL) {
+			// Only waits if the key changed again before the last retired block was done.
+			if (cached->retired != NULL) {
+				rspq_syncpoint_wait(cached->retired_sync);
+				rspq_block_free(cached->retired);
+			}
+			cached->retired = cached->block;
+			cached->retired_sync = rspq_syncpoint_new();
+		}
+
+		rspq_block_begin();
+		record();
+		cached->block = rspq_block_end();
+		cached->key = key;
+	}
+
+	rspq_block_run(cached->block);
+
+	// Blocks load their own textures.
+	tmem_invalidate();
+}
+
+static void record_hud() {
+	rdpq_set_mode_standard();
+	rdpq_mode_combiner(RDPQ_COMBINER_TEX);
+	rdpq_mode_blender(RDPQ_BLENDER((IN_RGB, IN_ALPHA, MEMORY_RGB, INV_MUX_ALPHA)));
+	rdpq_sync_load();
+	rdp_load_texture(0, 0, MIRROR_DISABLED, numbers_sprite);
+
+	if (game_state.score >= 10) {
+		render_digit(SCORE_X, SCORE_Y, game_state.score / 10);
 	}
 
+	render_digit(SCORE_X+10, SCORE_Y, game_state.score % 10);
+
+	render_digit(SCORE_X+20, SCORE_Y, 10);
+
+	uint16_t score_target = game_state.level->score_target;
+	render_digit(SCORE_X+30, SCORE_Y, score_target / 10);
+	render_digit(SCORE_X+40, SCORE_Y, score_target % 10);
+
+	render_digit(SCORE_X+50, SCORE_Y, 14);
+	render_digit(SCORE_X+58, SCORE_Y, 15);
+
+	render_digit(DEATH_X, SCORE_Y, game_state.snooper_death_count);
+	render_digit(DEATH_X+10, SCORE_Y, 10);
+	render_digit(DEATH_X+20, SCORE_Y, game_state.level->snooper_death_cap);
+	render_digit(DEATH_X+30, SCORE_Y, 12);
+	render_digit(DEATH_X+38, SCORE_Y, 13);
+}
+
+static void record_end_overlay() {
+	rdpq_set_mode_standard();
+	rdpq_mode_blender(RDPQ_BLENDER((IN_RGB, IN_ALPHA, MEMORY_RGB, INV_MUX_ALPHA)));
+
+	rdpq_mode_combiner(RDPQ_COMBINER_FLAT);
+	rdpq_set_prim_color(RGBA32(0xc0, 0xc0, 0xc0, 0x40));
+	rdpq_texture_rectangle(0, 35, 40, 30+250, 40+128, 0.f, 0.f, 1.f, 1.f);
+
+	rdpq_mode_combiner(RDPQ_COMBINER_TEX);
+	sprite_t *sprite = game_state.status == GAME_STATUS_WIN ? win_sprite : lose_sprite;
+
+	for (uint32_t y = 0; y < sprite->vslices; y++)
+	{
+		for (uint32_t x = 0; x < sprite->hslices; x++)
+		{
+			rdp_load_texture_stride(0, 0, MIRROR_DISABLED, sprite, y*sprite->hslices + x);
+			rdp_draw_sprite(0, 40 + x * (sprite->width / sprite->hslices), 40 + y * (sprite->height / sprite->vslices), MIRROR_DISABLED);
+		}
+	}
+}
+
+void render_toggle_painter_mode() {
+	painter_mode = !painter_mode;
+	debugf("painter mode %s\n", painter_mode ? "on" : "off");
+}
+
+void load_screen(const char *path) {
+	uint32_t trace_start = TICKS_READ();
+
+	// Screens draw over whatever the game left in the buffers and vice versa.
+	damage_reset(&screen_damage, SCREEN_WIDTH, SCREEN_HEIGHT);
+	damage_reset(&game_damage, SCREEN_WIDTH, SCREEN_HEIGHT);
+	screen_alpha = 0.f;
+
 	if (cur_screen_sprite != NULL) {
 		sprite_free(cur_screen_sprite);
 	}
@@ -541,6 +1263,8 @@ void load_screen(const char *path) {
 	if (path != NULL) {
 		cur_screen_sprite = sprite_load(path);
 	}
+
+	trace_record(TRACE_LOAD_SCREEN, trace_start, TICKS_READ());
 }
 
 bool render_screen(float alpha) {
@@ -552,94 +1276,104 @@ bool render_screen(float alpha) {
 
     rdp_attach(disp);
 
-	// find surface
-	int surface_index = 0;
-	for (int i = 0; i < ARRAY_LENGTH(screen_surface_alphas); i++) {
-		if (screen_surface_alphas[i].surface == disp) {
-			surface_index = i;
-			break;
-		}
-		if (screen_surface_alphas[i].surface == NULL) {
-			surface_index = i;
-		}
-	}
+	// The screen shows in a band around the middle that grows with alpha.
+	int last_half_height = (int)(screen_alpha * 240.f)/2;
+	int half_height = (int)(alpha * 240.f)/2;
+	screen_alpha = alpha;
 
-	if (screen_surface_alphas[surface_index].surface != disp) {
-		screen_surface_alphas[surface_index].surface = disp;
-		screen_surface_alphas[surface_index].alpha = 0.f;
+	if (half_height != last_half_height) {
+		int small_half_height = half_height < last_half_height ? half_height : last_half_height;
+		int big_half_height = half_height < last_half_height ? last_half_height : half_height;
+		damage_add(&screen_damage, 0, 120 - big_half_height, 320, 120 - small_half_height);
+		damage_add(&screen_damage, 0, 120 + small_half_height, 320, 120 + big_half_height);
 	}
 
-	float last_screen_alpha = screen_surface_alphas[surface_index].alpha;
-	screen_surface_alphas[surface_index].alpha = alpha;
+	damage_rect_t shown = {0, 120 - half_height, 320, 120 + half_height};
+	damage_rect_t top_band = {0, 0, 320, shown.y0};
+	damage_rect_t bottom_band = {0, shown.y1, 320, 240};
 
-	int last_rect_height = (int)(last_screen_alpha * 240.f);
-	int cur_rect_height = (int)(alpha * 240.f);
+	int slice_height = cur_screen_sprite->height / cur_screen_sprite->vslices;
+	int slice_width = cur_screen_sprite->width / cur_screen_sprite->hslices;
 
-	int big_rect_height;
-	int small_rect_height;
-	if (last_rect_height > cur_rect_height) {
-		big_rect_height = last_rect_height;
-		small_rect_height = cur_rect_height;
-	} else {
-		big_rect_height = cur_rect_height;
-		small_rect_height = last_rect_height;
-	}
+	damage_surface_t *damage = damage_begin(&screen_damage, disp);
+	for (int i = 0; i < damage->rect_count; i++) {
+		const damage_rect_t *rect = &damage->rects[i];
+		damage_rect_t part;
 
-	int update_top_min_y = 120 - big_rect_height/2;
-	int update_top_max_y = 120 - small_rect_height/2;
-	int update_bottom_min_y = 120 + small_rect_height/2;
-	int update_bottom_max_y = 120 + big_rect_height/2;
+		if (damage_rect_intersect(&part, rect, &shown)) {
+			rdpq_set_mode_standard();
+			rdpq_mode_combiner(RDPQ_COMBINER_TEX);
+			rdpq_set_scissor(part.x0, part.y0, part.x1, part.y1);
+
+			for (uint32_t y = 0; y < cur_screen_sprite->vslices; y++)
+			{
+				int screen_y = y * slice_height;
+				if (screen_y >= part.y1 || screen_y + slice_height <= part.y0) continue;
 
-	rdpq_set_mode_standard();
-	rdpq_mode_combiner(RDPQ_COMBINER_TEX);
-	int slice_height = cur_screen_sprite->height / cur_screen_sprite->vslices;
-	int slice_width = cur_screen_sprite->width / cur_screen_sprite->hslices;
-	if (cur_rect_height > last_rect_height) {
-		for (uint32_t y = 0; y < cur_screen_sprite->vslices; y++)
-		{
-			int screen_y = y * slice_height;
-			bool overlap_top = (
-				screen_y + slice_height >= update_top_min_y
-				&& screen_y <= update_top_max_y
-			);
-			bool overlap_bottom = (
-				screen_y + slice_height >= update_bottom_min_y
-				&& screen_y <= update_bottom_max_y
-			);
-
-			if (overlap_top || overlap_bottom) {
 				for (uint32_t x = 0; x < cur_screen_sprite->hslices; x++)
 				{
 					int screen_x = x * slice_width;
+					if (screen_x >= part.x1 || screen_x + slice_width <= part.x0) continue;
 
 					rdp_load_texture_stride(0, 0, MIRROR_DISABLED, cur_screen_sprite, y*cur_screen_sprite->hslices + x);
 					rdp_draw_sprite(0, screen_x, screen_y, MIRROR_DISABLED);
 				}
 			}
-		}
-	}
-
-	rdpq_set_mode_fill(RGBA32(0, 0, 0, 0xff));
 
-	int show_top = 120 - cur_rect_height/2;
-	int show_bottom = 120 + cur_rect_height/2;
+			rdpq_set_scissor(0, 0, 320, 240);
+		}
 
-	if (show_top > 0) rdpq_fill_rectangle(0, 0, 320, show_top);
-	if (show_bottom < 240) rdpq_fill_rectangle(0, show_bottom, 320, 240);
+		rdpq_set_mode_fill(RGBA32(0, 0, 0, 0xff));
+		if (damage_rect_intersect(&part, rect, &top_band)) {
+			rdpq_fill_rectangle(part.x0, part.y0, part.x1, part.y1);
+		}
+		if (damage_rect_intersect(&part, rect, &bottom_band)) {
+			rdpq_fill_rectangle(part.x0, part.y0, part.x1, part.y1);
+		}
+	}
+	damage_clear(damage);
 
 	rdp_detach_show(disp);
 
 	return true;
 }
 
-bool render() {
+bool render(float alpha) {
     surface_t *disp = display_lock();
     if (!disp)
     {
         return false;
     }
 
+	state_interpolate(&view, alpha);
+
 	tri_count = 0;
+	object_drawn_count = 0;
+	object_culled_count = 0;
+
+	// Anything could have been loaded since last frame.
+	tmem_invalidate();
+	tmem_reset_stats();
+
+	update_resolution_level();
+	const resolution_level_t *resolution = &resolution_levels[resolution_level];
+	profile_set_resolution(resolution->width, resolution->height);
+
+	// Below native the scene goes in its own surface, the z buffer is laid out to match.
+	surface_t *target = disp;
+	scene_zbuffer = zbuffer;
+	if (resolution_level != 0) {
+		scene_surface = surface_make(scene_buffer.buffer, FMT_RGBA16, resolution->width, resolution->height, 2*resolution->width);
+		scene_zbuffer = surface_make(zbuffer.buffer, FMT_RGBA16, resolution->width, resolution->height, 2*resolution->width);
+		target = &scene_surface;
+
+		scene_sprite.width = resolution->width;
+		scene_sprite.height = resolution->height;
+		scene_sprite.hslices = resolution->hslices;
+		scene_sprite.vslices = resolution->vslices;
+	}
+
+	profile_begin(PROFILE_LIGHT);
 	
 	/*
 	int16_t closest_node = -1;
@@ -659,19 +1393,26 @@ bool render() {
 	}
 	*/
 
-	// Clear the z buffer.
-	clear_z_buffer();
+	// Clear the z buffer. Painter mode only clears the parts it uses.
+	if (!painter_mode) {
+		clear_z_buffer();
+	}
+
+	surface_t *light_surface = &light_surfaces[light_draw_index];
+	const surface_t *last_light_surface = &light_surfaces[light_draw_index ^ 1];
+	light_draw_index ^= 1;
 
-	rdpq_set_color_image(&light_surface);
+	rdpq_set_color_image(light_surface);
 
 	// update_framebuffer_size assumes the surface exactly covers the screen
 	// but it doesn't!
-	// update_framebuffer_size(&light_surface);
-	half_framebuffer_width = 32;
-	half_framebuffer_height = 31;
+	// update_framebuffer_size(light_surface);
+	camera.half_width = 32;
+	camera.half_height = 31;
 
-	camera_wx_factor = 32/160.f * 0.16f;
-	camera_wy_factor = 30/120.f * 0.16f;
+	camera.wx_factor = 32/160.f * 0.16f;
+	camera.wy_factor = 30/120.f * 0.16f;
+	update_cull_planes();
 
 	rdpq_set_mode_fill(RGBA32(0x00, 0x00, 0x20, 0xff));
 	rdpq_fill_rectangle(0, 0, LIGHT_SURFACE_WIDTH, LIGHT_SURFACE_HEIGHT);
@@ -684,59 +1425,34 @@ bool render() {
 	rdpq_mode_zbuf(false, false);
 
 	rdpq_mode_combiner(RDPQ_COMBINER_TEX_FLAT);
-	object_transform_t work_transform = {{0.f, 0.f, 0.f}, 0.f};
+	object_transform_t work_transform = {{0.f, 0.f, 0.f}, 0};
 	rdpq_set_blend_color(RGBA32(0, 0, 0xff, 0xff));
 	rdpq_mode_blender(RDPQ_BLENDER((BLEND_RGB, IN_ALPHA, MEMORY_RGB, INV_MUX_ALPHA)));
 	rdpq_mode_persp(true);
 	rdpq_mode_mipmap(MIPMAP_NONE, 0);
-	rdpq_sync_load();
-	// rdp_load_texture(0, 0, MIRROR_DISABLED, snooper_light_sprite);
-	rdp_load_texture_stride_hax(0, 0, MIRROR_DISABLED, snooper_light_sprite, snooper_light_sprite->data, 0);
-
-	for (int i = 0; i < game_state.snooper_count; i++) {
-		snooper_state_t *snooper = &game_state.snoopers[i];
-		if (snooper->status != SNOOPER_STATUS_ALIVE) continue;
-
-		float s = sinf(snooper->head_rotation_z);
-		float c = cosf(snooper->head_rotation_z);
-
-		float end_x = snooper->position.x + 6.f * s;
-		float end_y = snooper->position.y + 6.f * c;
-		if (!(
-			should_render(snooper->position.x, snooper->position.y)
-			|| should_render(end_x, end_y)
-		)) {
-			continue;
-		}
+	tmem_load_sprite(snooper_light_sprite);
+
+	const snooper_pool_t *snoopers = &game_state.snoopers;
+	for (int i = 0; i < snoopers->slot_limit; i++) {
+		if (snoopers->status[i] != SNOOPER_STATUS_ALIVE) continue;
 
-		work_transform.position.x = snooper->position.x;
-		work_transform.position.y = snooper->position.y;
-		work_transform.rotation_z = snooper->head_rotation_z;
+		work_transform.position.x = view.snooper_position[i].x;
+		work_transform.position.y = view.snooper_position[i].y;
+		work_transform.rotation_z = view.snooper_head_rotation_z[i];
 
-		rdpq_set_prim_color(RGBA32(0xff, 0xff, 0xff, snooper->light_brightness * 255 / 100));
+		rdpq_set_prim_color(RGBA32(0xff, 0xff, 0xff, snoopers->light_brightness[i] * 255 / 100));
 
 		// render_model_positioned(&work_transform.position, &light_model);
 		// TODO : no shade?
 		render_object_transformed_shaded(&work_transform, &light_model);
 	}
 
-	rdpq_sync_load();
-	rdp_load_texture_stride_hax(0, 0, MIRROR_DISABLED, level_light_sprite, level_light_sprite->data, 0);
+	tmem_load_sprite(level_light_sprite);
 	for (int i = 0; i < game_state.level->light_count; i++) {
 		const level_light_t *light = &game_state.level->lights[i];
-		const level_light_state_t *light_state = &game_state.light_states[i];
-
-		work_transform.position.x = light_state->position.x;
-		work_transform.position.y = light_state->position.y;
-
-		if (!(
-			should_render(work_transform.position.x - light->radius, work_transform.position.y - light->radius)
-			|| should_render(work_transform.position.x + light->radius, work_transform.position.y - light->radius)
-			|| should_render(work_transform.position.x - light->radius, work_transform.position.y + light->radius)
-			|| should_render(work_transform.position.x + light->radius, work_transform.position.y + light->radius)
-		)) {
-			continue;
-		}
+
+		work_transform.position.x = view.light_position[i].x;
+		work_transform.position.y = view.light_position[i].y;
 
 		level_light_model.positions[0] = -light->radius;
 		level_light_model.positions[1] = -light->radius;
@@ -750,13 +1466,14 @@ bool render() {
 		level_light_model.positions[9] = light->radius;
 		level_light_model.positions[10] = light->radius;
 
+		level_light_model.bounds_radius = light->radius * 1.41421356f;
+		model_changed(&level_light_model);
+
 		rdpq_set_prim_color(RGBA32(0xff, 0xff, 0xff, game_state.light_states[i].brightness*255/100));
 		render_model_positioned(&work_transform.position, &level_light_model);
 	}
 
-	// There's some glitchy stuff going on with the lights and I'm not sure why
-	// but maybe this will help???
-	rspq_wait();
+	profile_end(PROFILE_LIGHT);
 
     rdp_attach(disp);
 	update_framebuffer_size(disp);
@@ -764,12 +1481,16 @@ bool render() {
 	// TODO : set color image to light buffer?
 	rdpq_set_z_image(&zbuffer);
 
-	// Clear the framebuffer.
-	rdpq_set_mode_fill(RGBA32(0, 0, 0, 0));
-	rdpq_fill_rectangle(0, 0, 320, 240);
+	damage_surface_t *damage = damage_begin(&game_damage, disp);
 
 	if (game_state.status == GAME_STATUS_START) {
-		rspq_wait();
+		// Clear the framebuffer.
+		rdpq_set_mode_fill(RGBA32(0, 0, 0, 0));
+		rdpq_fill_rectangle(0, 0, 320, 240);
+		damage_add(&game_damage, 0, 0, 320, 240);
+		damage_clear(damage);
+
+		text_set_mode();
 
 		float progress = game_state.game_status_timer / (float)GAME_START_DURATION;
 		float alpha = 1.f;
@@ -778,10 +1499,7 @@ bool render() {
 		} else if (progress > 0.8f) {
 			alpha = (1.f - progress) / 0.2f;
 		}
-		uint8_t v = (uint8_t)(255.f * alpha);
-
-		graphics_set_color(graphics_make_color(v, v, v, 0xff), 0);
-		graphics_draw_text(disp, 124, 100, game_state.level->name);
+		text_label_draw(&level_name_label, 124, 100, (uint8_t)(255.f * alpha));
 
 		alpha = 1.f;
 		if (progress < 0.2f) {
@@ -792,11 +1510,7 @@ bool render() {
 			alpha = (1.f - progress) / 0.2f;
 		}
 
-		char snooper_count_str[32];
-		sprintf(snooper_count_str, "Spook %d Snoopers", game_state.level->score_target);
-		v = (uint8_t)(255.f * alpha);
-		graphics_set_color(graphics_make_color(v, v, v, 0xff), 0);
-		graphics_draw_text(disp, 84, 115, snooper_count_str);
+		text_label_draw(&level_goal_label, 84, 115, (uint8_t)(255.f * alpha));
 	} else {
 		float visibility;
 		if (game_state.status == GAME_STATUS_WIN || game_state.status == GAME_STATUS_LOSE) {
@@ -809,10 +1523,47 @@ bool render() {
 		if (visibility > 1.f) visibility = 1.f;
 		int scissor_half_height = (int)(120.f * visibility);
 		if (scissor_half_height <= 0) scissor_half_height = 1;
+
+		// Black out the parts of the letterbox bands that still have an old frame in them.
+		damage_rect_t top_band = {0, 0, 320, 120 - scissor_half_height};
+		damage_rect_t bottom_band = {0, 120 + scissor_half_height, 320, 240};
+		rdpq_set_mode_fill(RGBA32(0, 0, 0, 0));
+		for (int i = 0; i < damage->rect_count; i++) {
+			damage_rect_t part;
+			if (damage_rect_intersect(&part, &damage->rects[i], &top_band)) {
+				rdpq_fill_rectangle(part.x0, part.y0, part.x1, part.y1);
+			}
+			if (damage_rect_intersect(&part, &damage->rects[i], &bottom_band)) {
+				rdpq_fill_rectangle(part.x0, part.y0, part.x1, part.y1);
+			}
+		}
+
+		// The scene changes every frame, so it's stale in every other buffer.
+		damage_add(&game_damage, 0, top_band.y1, 320, bottom_band.y0);
+		damage_clear(damage);
+
+		// The window in scene pixels, rounded out so the upscale covers all of it.
+		scene_scissor.x0 = 0;
+		scene_scissor.y0 = top_band.y1 * resolution->height / SCREEN_HEIGHT;
+		scene_scissor.x1 = resolution->width;
+		scene_scissor.y1 = (bottom_band.y0 * resolution->height + SCREEN_HEIGHT - 1) / SCREEN_HEIGHT;
+
+		if (target != disp) {
+			rdpq_set_color_image(target);
+			rdpq_set_z_image(&scene_zbuffer);
+			update_framebuffer_size(target);
+		}
+
+		// Clear the framebuffer.
+		rdpq_fill_rectangle(scene_scissor.x0, scene_scissor.y0, scene_scissor.x1, scene_scissor.y1);
+
 		if (scissor_half_height < 120) {
-			rdpq_set_scissor(0, 120 - scissor_half_height, 320, 120 + scissor_half_height);
+			rdpq_set_scissor(scene_scissor.x0, scene_scissor.y0, scene_scissor.x1, scene_scissor.y1);
 		}
 
+		profile_begin(PROFILE_LEVEL);
+		bucket_visible_level();
+
 		// Render floor
 		rdpq_set_mode_standard();
 		rdpq_mode_persp(true);
@@ -822,9 +1573,8 @@ bool render() {
 
 		rdpq_mode_combiner(RDPQ_COMBINER_TEX);
 
-		rdpq_sync_load();
-		rdp_load_texture(0, 0, MIRROR_DISABLED, floor_sprite);
-		foreach_level_element(render_floor);
+		tmem_load_sprite(floor_sprite);
+		render_level_bucket(LEVEL_LAYER_FLOOR);
 
 		// Apply lights
 		rdpq_sync_pipe();
@@ -836,195 +1586,81 @@ bool render() {
 		rdpq_mode_blender(RDPQ_BLENDER((MEMORY_RGB, IN_ALPHA, BLEND_RGB, ONE)));
 
 		// int y = 0;
-		rdpq_sync_load();
-		rdp_load_texture_stride_hax(0, 0, MIRROR_DISABLED, &light_surface_sprite, light_surface.buffer, 0);
+		int scene_width = resolution->width;
+		int scene_height = resolution->height;
+
+		tmem_load(&light_surface_sprite, last_light_surface->buffer, 0);
 		rdpq_texture_rectangle_fx(
 			0, // tile
 			0, // x0
 			0, // y0
-			320*4, // x1
-			120*4, // y1
+			scene_width*4, // x1
+			scene_height/2*4, // y1
 			0, //s
 			32, //t
-			1024.f * LIGHT_SURFACE_WIDTH / 320.f, // dsdx
-			1024.f * (60) / 240.f); // dtdy
-
-		rdpq_sync_load();
-		rdp_load_texture_stride_hax(
-			0, 0, MIRROR_DISABLED, &light_surface_sprite,
-			light_surface.buffer + (2 * LIGHT_SURFACE_WIDTH * (30)),
-			0);
+			1024.f * LIGHT_SURFACE_WIDTH / scene_width, // dsdx
+			1024.f * (60) / scene_height); // dtdy
+
+		tmem_load(&light_surface_sprite, last_light_surface->buffer + (2 * LIGHT_SURFACE_WIDTH * (30)), 0);
 		rdpq_texture_rectangle_fx(
 			0, // tile
 			0, // x0
-			120*4, // y0
-			320*4, // x1
-			240*4, // y1
+			scene_height/2*4, // y0
+			scene_width*4, // x1
+			scene_height*4, // y1
 			0, //s
 			32, //t
-			1024.f * LIGHT_SURFACE_WIDTH / 320.f, // dsdx
-			1024.f * (60) / 240.f); // dtdy
-
-		// Render walls
-		rdpq_set_mode_standard();
-		rdpq_mode_persp(true);
-		rdpq_change_other_modes_raw(SOM_SAMPLE_MASK, SOM_SAMPLE_BILINEAR);
-		rdpq_mode_zbuf(true, true);
-		// rdpq_change_other_modes_raw(SOM_AA_ENABLE, SOM_AA_ENABLE);
-		rdpq_mode_mipmap(MIPMAP_NONE, 0);
+			1024.f * LIGHT_SURFACE_WIDTH / scene_width, // dsdx
+			1024.f * (60) / scene_height); // dtdy
 
-		rdpq_mode_combiner(RDPQ_COMBINER_TEX_FLAT);
-
-		rdpq_set_prim_color(RGBA32(0x20, 0x20, 0x20, 0xff));
-
-		rdpq_sync_load();
-		rdp_load_texture(0, 0, MIRROR_DISABLED, wall_sprite);
-		foreach_level_element(render_wall);
-
-		rdpq_sync_load();
-		rdp_load_texture(0, 0, MIRROR_DISABLED, roof_sprite);
-		foreach_level_element(render_roof);
-
-		// Render paths
-		// render_graph(game_state.level->path_graph, closest_node);
-
-		// Render spooker outlines
-		rdpq_set_mode_standard();
-		rdpq_set_other_modes_raw(SOM_TEXTURE_PERSP);
-		rdpq_change_other_modes_raw(SOM_SAMPLE_MASK, SOM_SAMPLE_BILINEAR);
-		rdpq_change_other_modes_raw(SOM_TF_MASK, SOM_TF0_RGB);
-		rdpq_mode_mipmap(MIPMAP_NONE, 0);
-		rdpq_mode_zbuf(false, false);
-		rdpq_mode_combiner(RDPQ_COMBINER_FLAT);
-		rdpq_mode_blender(RDPQ_BLENDER((IN_RGB, IN_ALPHA, MEMORY_RGB, INV_MUX_ALPHA)));
-		rdpq_set_prim_color(RGBA32(0, 0x0, 0x0, 0xc0));
-		for (int i = 0; i < game_state.spooker_count; i++) {
-			spooker_state_t *spooker = &game_state.spookers[i];
-			if (spooker->knockback_timer < SPOOKER_KNOCKBACK_THRESHOLD && spooker->knockback_timer % 4 >= 2) continue;
-			render_object_transformed_shaded(&spooker->transform, &spooker_model);
+		if (painter_mode) {
+			render_scene_painter(target);
+		} else {
+			render_scene_depth();
 		}
 
-		// Render spookers
-		rdpq_mode_zbuf(true, true);
-		rdpq_mode_combiner(RDPQ_COMBINER_TEX_SHADE);
-		rdpq_mode_blender(RDPQ_BLENDER((IN_RGB, IN_ALPHA, IN_RGB, INV_MUX_ALPHA)));
-		rdpq_sync_load();
-		rdp_load_texture(0, 0, MIRROR_DISABLED, spooker_sprite);
-		for (int i = 0; i < game_state.spooker_count; i++) {
-			spooker_state_t *spooker = &game_state.spookers[i];
-			if (spooker->knockback_timer < SPOOKER_KNOCKBACK_THRESHOLD && spooker->knockback_timer % 4 >= 2) continue;
-			render_object_transformed_shaded(&spooker->transform, &spooker_model);
+		// The HUD is drawn over the upscaled scene at native resolution.
+		if (target != disp) {
+			upscale_scene(disp, top_band.y1, bottom_band.y0);
+			update_framebuffer_size(disp);
 		}
 
-		// Render snoopers
-		rdpq_sync_load();
-		rdp_load_texture(0, 0, MIRROR_DISABLED, snooper_sprite);
-		for (int i = 0; i < game_state.snooper_count; i++) {
-			snooper_state_t *snooper = &game_state.snoopers[i];
-			if (!should_render(snooper->position.x, snooper->position.y)) continue;
-
-			work_transform.position.x = snooper->position.x;
-			work_transform.position.y = snooper->position.y;
-			work_transform.rotation_z = snooper->head_rotation_z;
-
-			if (snooper->status == SNOOPER_STATUS_DYING) {
-				float progress = snooper->freeze_timer / (float)SNOOPER_DIE_DURATION;
-				work_transform.position.z = -10.f * progress * progress;
-			} else if (snooper->status == SNOOPER_STATUS_SPOOKED) {
-				float t = snooper->spooked_timer / 8.f;
-				if (t > 1.0f) t = 1.0f;
-				work_transform.position.z = 4.f * t * (1.f - t);
-			} else {
-				work_transform.position.z = 0.f;
-			}
-
-			int animation_index = ARRAY_LENGTH(snooper_models) * snooper->animation_progress;
-			render_object_transformed_shaded(&work_transform, snooper_models[animation_index]);
-			work_transform.rotation_z = snooper->feet_rotation_z;
-			render_object_transformed_shaded(&work_transform, snooper_feet_models[animation_index]);
-		}
+		profile_begin(PROFILE_HUD);
 
 		// Render score
-		rdpq_set_mode_standard();
-		rdpq_mode_combiner(RDPQ_COMBINER_TEX);
-		rdpq_mode_blender(RDPQ_BLENDER((IN_RGB, IN_ALPHA, MEMORY_RGB, INV_MUX_ALPHA)));
-		rdpq_sync_load();
-		rdp_load_texture(0, 0, MIRROR_DISABLED, numbers_sprite);
-
-		if (game_state.score >= 10) {
-			render_digit(SCORE_X, SCORE_Y, game_state.score / 10);
-		}
-
-		render_digit(SCORE_X+10, SCORE_Y, game_state.score % 10);
-
-		render_digit(SCORE_X+20, SCORE_Y, 10);
-
-		uint16_t score_target = game_state.level->score_target;
-		render_digit(SCORE_X+30, SCORE_Y, score_target / 10);
-		render_digit(SCORE_X+40, SCORE_Y, score_target % 10);
-
-		render_digit(SCORE_X+50, SCORE_Y, 14);
-		render_digit(SCORE_X+58, SCORE_Y, 15);
-
-		render_digit(DEATH_X, SCORE_Y, game_state.snooper_death_count);
-		render_digit(DEATH_X+10, SCORE_Y, 10);
-		render_digit(DEATH_X+20, SCORE_Y, game_state.level->snooper_death_cap);
-		render_digit(DEATH_X+30, SCORE_Y, 12);
-		render_digit(DEATH_X+38, SCORE_Y, 13);
+		uint64_t hud_key = (
+			(uint64_t)game_state.score
+			| (uint64_t)game_state.level->score_target << 16
+			| (uint64_t)game_state.snooper_death_count << 32
+			| (uint64_t)game_state.level->snooper_death_cap << 48
+		);
+		cached_block_run(&hud_block, hud_key, record_hud);
 
 		if (game_state.status == GAME_STATUS_WIN || game_state.status == GAME_STATUS_LOSE) {
-			rdpq_mode_combiner(RDPQ_COMBINER_FLAT);
-			rdpq_set_prim_color(RGBA32(0xc0, 0xc0, 0xc0, 0x40));
-			rdpq_texture_rectangle(0, 35, 40, 30+250, 40+128, 0.f, 0.f, 1.f, 1.f);
-
-			rdpq_mode_combiner(RDPQ_COMBINER_TEX);
-			sprite_t *sprite = game_state.status == GAME_STATUS_WIN ? win_sprite : lose_sprite;
-
-			for (uint32_t y = 0; y < sprite->vslices; y++)
-			{
-				for (uint32_t x = 0; x < sprite->hslices; x++)
-				{
-					rdp_load_texture_stride(0, 0, MIRROR_DISABLED, sprite, y*sprite->hslices + x);
-					rdp_draw_sprite(0, 40 + x * (sprite->width / sprite->hslices), 40 + y * (sprite->height / sprite->vslices), MIRROR_DISABLED);
-				}
-			}
+			cached_block_run(&end_overlay_block, game_state.status, record_end_overlay);
 		}
-	}
-
-	/*
-	char info_str[64];
-	sprintf(info_str, "%ldFPS", fps);
 
-	rspq_wait();
-	graphics_set_color(0xFFFFFFFF, 0x00000000);
-	graphics_draw_text(disp, 6, 2, info_str);
-
-	{
-		const vector3_t *spooker_position = &game_state.spookers[0].transform.position;
-		sprintf(info_str, "%d %.1f %.1f %ld", closest_node, spooker_position->x, spooker_position->y, tri_count);
+		profile_end(PROFILE_HUD);
 	}
 
-	graphics_draw_text(disp, 60, 2, info_str);
-	graphics_draw_text(disp, 6, 10, debug_message);
-	*/
+	if (profile_enabled()) {
+		// Drawn with the CPU font, so this waits for the RDP and adds a little to the timings.
+		rspq_wait();
+		graphics_set_color(0xFFFFFFFF, 0x00000000);
+		int y = profile_draw_overlay(disp, 6, 2);
+
+		char info_str[64];
+		snprintf(info_str, sizeof(info_str), "%lu tris %lu/%lu obj %luB tmem",
+			(unsigned long)tri_count, (unsigned long)object_drawn_count,
+			(unsigned long)object_culled_count, (unsigned long)tmem_bytes_loaded());
+		graphics_draw_text(disp, 6, y, info_str);
+		graphics_draw_text(disp, 6, y + 8, debug_message);
+
+		// The bands outside the scene are only redrawn when damaged.
+		damage_add(&game_damage, 0, 0, 320, y + 16);
+	}
 
 	rdp_detach_show(disp);
 
-	/*
-	fps_frame_count++;
-	if (fps_frame_count >= 10) {
-		long long now = timer_ticks();
-		long long fps_ticks = now - fps_start_tick;
-		fps_start_tick = now;
-		fps_frame_count = 0;
-
-		float frame_seconds = ((float)fps_ticks) / 468750000.0f;
-
-		fps = (int)(1.0f / frame_seconds + 0.5f);
-		if (fps < 0) fps = 0;
-		if (fps > 99) fps = 99;
-	}
-	*/
-
 	return true;
 }
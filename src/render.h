@@ -4,42 +4,145 @@
 #include <stdint.h>
 #include "dragon.h"
 #include "vector.h"
+#include "angle.h"
+#include "level.h"
+#include "arena.h"
 
-typedef struct {
+typedef struct model_s {
 	uint16_t positions_len;
 	uint16_t texcoords_len;
 	uint16_t norms_len;
+	uint16_t verts_len;
 	uint16_t tris_len;
+	uint16_t strips_len;
 
 	float *positions;
 	float *texcoords;
 	float *norms;
 
+	// Position, texcoord and normal index of each unique vertex.
+	uint16_t *verts;
+	// Vertex indices, 3 per triangle.
 	uint16_t *tris;
+	// Triangle strips of vertex indices, separated by STRIP_RESTART.
+	uint16_t *strips;
+
+	// Bounding sphere in model space.
+	vector3_t bounds_center;
+	float bounds_radius;
+
+	// Lower detail version to draw when the model is small on screen, or NULL.
+	const struct model_s *lod;
+
+	// positions and norms in s15.16 for the fixed point pipeline, see model_update_fixed.
+	int32_t *fixed_positions;
+	int32_t *fixed_norms;
 } model_t;
 
+#define STRIP_RESTART 0xffff
+
 typedef struct {
 	vector3_t position;
-	float rotation_z;
+	angle_t rotation_z;
 } object_transform_t;
 
-#define MODEL(positions, texcoords, norms, tris) {\
+#define MODEL(positions, texcoords, norms, verts, tris, strips) {\
+	sizeof(positions)/sizeof(float),\
+	sizeof(texcoords)/sizeof(float),\
+	sizeof(norms)/sizeof(float),\
+	sizeof(verts)/sizeof(uint16_t),\
+	sizeof(tris)/sizeof(uint16_t),\
+	sizeof(strips)/sizeof(uint16_t),\
+	positions,\
+	texcoords,\
+	norms,\
+	verts,\
+	tris,\
+	strips}
+
+#define MODEL_BOUNDED(positions, texcoords, norms, verts, tris, strips, center_x, center_y, center_z, radius, lod, fixed_positions, fixed_norms) {\
 	sizeof(positions)/sizeof(float),\
 	sizeof(texcoords)/sizeof(float),\
 	sizeof(norms)/sizeof(float),\
+	sizeof(verts)/sizeof(uint16_t),\
 	sizeof(tris)/sizeof(uint16_t),\
+	sizeof(strips)/sizeof(uint16_t),\
 	positions,\
 	texcoords,\
 	norms,\
-	tris}
+	verts,\
+	tris,\
+	strips,\
+	{center_x, center_y, center_z},\
+	radius,\
+	lod,\
+	fixed_positions,\
+	fixed_norms}
+
+// Decimated version of a model. It shares the model's arrays and only uses
+// the first positions_len positions and norms_len normals, so animation
+// decoded into the full model drives every level of detail.
+#define MODEL_LOD(positions, positions_len, texcoords, norms, norms_len, verts, tris, strips, center_x, center_y, center_z, radius, lod, fixed_positions, fixed_norms) {\
+	positions_len,\
+	sizeof(texcoords)/sizeof(float),\
+	norms_len,\
+	sizeof(verts)/sizeof(uint16_t),\
+	sizeof(tris)/sizeof(uint16_t),\
+	sizeof(strips)/sizeof(uint16_t),\
+	positions,\
+	texcoords,\
+	norms,\
+	verts,\
+	tris,\
+	strips,\
+	{center_x, center_y, center_z},\
+	radius,\
+	lod,\
+	fixed_positions,\
+	fixed_norms}
+
+// Vertex animation over one shared topology.
+// Each frame is stored as int8 position offsets from the base positions
+// plus int8 normals, and decoded into the model's positions and norms,
+// or their fixed point versions.
+typedef struct {
+	model_t *model;
+	uint16_t frame_count;
+	const float *base_positions;
+	const int32_t *fixed_base_positions;
+	const int8_t *frame_offsets;
+	float offset_scale;
+	const int8_t *frame_norms;
+} model_animation_t;
+
+#define MODEL_ANIMATION(model, base_positions, fixed_base_positions, frame_offsets, offset_scale, frame_norms) {\
+	&model,\
+	sizeof(frame_offsets)/(sizeof(base_positions)/sizeof(float)),\
+	base_positions,\
+	fixed_base_positions,\
+	frame_offsets,\
+	offset_scale,\
+	frame_norms}
 
-bool render();
+// alpha is how far between the previous and current simulation tick to draw, 0 to 1.
+bool render(float alpha);
 void renderer_init();
 void clear_z_buffer();
 void render_object_transformed_shaded(const object_transform_t *transform, const model_t *model);
+void model_compute_bounds(model_t *model);
 void set_camera_pitch(float camera_pitch);
+// For drawing outside of render(), which sets the camera from game_state.
+void set_camera_position(const vector3_t *position);
 void load_screen(const char *path);
 bool render_screen(float alpha);
+// Per-level render data is allocated from the arena, it lives until the arena is reset.
+void render_load_level(const level_t *level, arena_t *arena);
+// Most render_load_level can take from the arena.
+size_t render_level_arena_size(const level_t *level);
+// Debug: draws the level back to front instead of clearing the z buffer.
+void render_toggle_painter_mode();
+// Debug: when off the scene is always drawn at native resolution.
+void render_toggle_dynamic_resolution();
 
 extern surface_t zbuffer;
 extern float camera_position[];
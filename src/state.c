@@ -1,9 +1,15 @@
 #include "state.h"
 #include "dragon.h"
 #include "math.h"
+#include <stdio.h>
+#include <malloc.h>
+#include <string.h>
 #include "rand.h"
 
 #include "sfx.h"
+#include "grid.h"
+#include "profile.h"
+#include "trace.h"
 
 #define SPOOK_DISTANCE 3.0f
 
@@ -11,13 +17,17 @@
 #define SNOOPER_MIN_Y 0.f
 #define SNOOPER_SPEED 0.08f
 #define SNOOPER_RUN_SPEED 0.6f
-#define SNOOPER_LIGHT_ANGLE (0.17f * M_PI)
+#define SNOOPER_LIGHT_ANGLE ANGLE_FROM_RADIANS(0.17f * M_PI)
 #define SNOOPER_LIGHT_MAX_DIST 5.5f
 #define SNOOPER_LIGHT_MIN_DIST 1.f
 #define SNOOPER_LOOK_DIST 8.f
+#define SNOOPER_HEAD_WANDER ANGLE_FROM_RADIANS(M_PI/3.0f)
 
 #define SPOOKER_SPEED 0.35f
+#define SPOOKER_STOP_SPEED 1e-7f
 #define SPOOKER_KNOCKBACK_DURATION 30
+// Per knockback frame left, in angle units.
+#define SPOOKER_KNOCKBACK_SPIN ANGLE_FROM_RADIANS(0.02f)
 
 #define CAMERA_OFFSET_Y -12.f
 #define CAMERA_OFFSET_Z 12.f
@@ -34,6 +44,164 @@
 
 game_state_t game_state;
 
+// Everything sized by the level is carved out of this, and thrown away by the next load_level.
+// state_init allocates it once, big enough for the biggest level, so switching levels never touches the heap.
+static arena_t level_arena;
+
+static grid_t snooper_grid;
+static grid_t light_grid;
+
+static void alloc_snooper_pool(snooper_pool_t *snoopers, uint16_t capacity) {
+	snoopers->status = ARENA_ALLOC_ARRAY(&level_arena, snooper_status_t, capacity);
+	snoopers->position = ARENA_ALLOC_ARRAY(&level_arena, vector2_t, capacity);
+	snoopers->head_rotation_z = ARENA_ALLOC_ARRAY(&level_arena, angle_t, capacity);
+	snoopers->feet_rotation_z = ARENA_ALLOC_ARRAY(&level_arena, angle_t, capacity);
+	snoopers->freeze_timer = ARENA_ALLOC_ARRAY(&level_arena, uint16_t, capacity);
+	snoopers->animation_progress = ARENA_ALLOC_ARRAY(&level_arena, float, capacity);
+	snoopers->light_brightness = ARENA_ALLOC_ARRAY(&level_arena, uint16_t, capacity);
+
+	snoopers->head_target_rotation_z = ARENA_ALLOC_ARRAY(&level_arena, angle_t, capacity);
+	snoopers->rotate_timer = ARENA_ALLOC_ARRAY(&level_arena, uint16_t, capacity);
+	snoopers->spooked_timer = ARENA_ALLOC_ARRAY(&level_arena, uint16_t, capacity);
+	snoopers->path_follower = ARENA_ALLOC_ARRAY(&level_arena, path_follower_t, capacity);
+
+	snoopers->generation = ARENA_ALLOC_ARRAY(&level_arena, uint8_t, capacity);
+	memset(snoopers->generation, 0, capacity);
+
+	snoopers->free_slots = ARENA_ALLOC_ARRAY(&level_arena, uint16_t, capacity);
+	snoopers->free_count = 0;
+	snoopers->slot_limit = 0;
+	snoopers->capacity = capacity;
+	snoopers->count = 0;
+}
+
+static size_t snooper_pool_arena_size(uint16_t capacity) {
+	return ARENA_ARRAY_SIZE(snooper_status_t, capacity)
+		+ ARENA_ARRAY_SIZE(vector2_t, capacity)
+		+ 3*ARENA_ARRAY_SIZE(angle_t, capacity)
+		+ 4*ARENA_ARRAY_SIZE(uint16_t, capacity)
+		+ ARENA_ARRAY_SIZE(float, capacity)
+		+ ARENA_ARRAY_SIZE(path_follower_t, capacity)
+		+ ARENA_ARRAY_SIZE(uint8_t, capacity)
+		+ ARENA_ARRAY_SIZE(uint16_t, capacity);
+}
+
+void state_snapshot_alloc(state_snapshot_t *snapshot, const level_t *level, arena_t *arena) {
+	snapshot->spookers = ARENA_ALLOC_ARRAY(arena, object_transform_t, level->max_spooker_count);
+	snapshot->snooper_position = ARENA_ALLOC_ARRAY(arena, vector2_t, level->max_snooper_count);
+	snapshot->snooper_head_rotation_z = ARENA_ALLOC_ARRAY(arena, angle_t, level->max_snooper_count);
+	snapshot->snooper_feet_rotation_z = ARENA_ALLOC_ARRAY(arena, angle_t, level->max_snooper_count);
+	snapshot->snooper_animation_progress = ARENA_ALLOC_ARRAY(arena, float, level->max_snooper_count);
+	snapshot->light_position = ARENA_ALLOC_ARRAY(arena, vector2_t, level->light_count);
+}
+
+size_t state_snapshot_arena_size(const level_t *level) {
+	return ARENA_ARRAY_SIZE(object_transform_t, level->max_spooker_count)
+		+ ARENA_ARRAY_SIZE(vector2_t, level->max_snooper_count)
+		+ 2*ARENA_ARRAY_SIZE(angle_t, level->max_snooper_count)
+		+ ARENA_ARRAY_SIZE(float, level->max_snooper_count)
+		+ ARENA_ARRAY_SIZE(vector2_t, level->light_count);
+}
+
+static void capture_snapshot(state_snapshot_t *snapshot) {
+	snapshot->camera_position = game_state.camera_position;
+	for (uint16_t i = 0; i < game_state.spooker_count; i++) {
+		snapshot->spookers[i] = game_state.spookers[i].transform;
+	}
+
+	const snooper_pool_t *snoopers = &game_state.snoopers;
+	memcpy(snapshot->snooper_position, snoopers->position, snoopers->slot_limit*sizeof(vector2_t));
+	memcpy(snapshot->snooper_head_rotation_z, snoopers->head_rotation_z, snoopers->slot_limit*sizeof(angle_t));
+	memcpy(snapshot->snooper_feet_rotation_z, snoopers->feet_rotation_z, snoopers->slot_limit*sizeof(angle_t));
+	memcpy(snapshot->snooper_animation_progress, snoopers->animation_progress, snoopers->slot_limit*sizeof(float));
+
+	for (uint8_t i = 0; i < game_state.level->light_count; i++) {
+		snapshot->light_position[i] = game_state.light_states[i].position;
+	}
+}
+
+static inline float lerpf(float a, float b, float t) {
+	return (1.f - t)*a + t*b;
+}
+
+// For 0 to 1 values that only go forward and wrap around at 1, like animation progress.
+static float lerp_wrapped(float a, float b, float t) {
+	if (b < a) b += 1.f;
+	float x = lerpf(a, b, t);
+	return x >= 1.f ? x - 1.f : x;
+}
+
+void state_interpolate(state_snapshot_t *out, float alpha) {
+	const state_snapshot_t *previous = &game_state.previous;
+
+	out->camera_position.x = lerpf(previous->camera_position.x, game_state.camera_position.x, alpha);
+	out->camera_position.y = lerpf(previous->camera_position.y, game_state.camera_position.y, alpha);
+	out->camera_position.z = lerpf(previous->camera_position.z, game_state.camera_position.z, alpha);
+
+	for (uint16_t i = 0; i < game_state.spooker_count; i++) {
+		const object_transform_t *from = &previous->spookers[i];
+		const object_transform_t *to = &game_state.spookers[i].transform;
+		out->spookers[i].position.x = lerpf(from->position.x, to->position.x, alpha);
+		out->spookers[i].position.y = lerpf(from->position.y, to->position.y, alpha);
+		out->spookers[i].position.z = lerpf(from->position.z, to->position.z, alpha);
+		out->spookers[i].rotation_z = angle_lerp(from->rotation_z, to->rotation_z, alpha);
+	}
+
+	const snooper_pool_t *snoopers = &game_state.snoopers;
+	for (uint16_t i = 0; i < snoopers->slot_limit; i++) {
+		if (snoopers->status[i] == SNOOPER_STATUS_DEAD) continue;
+		out->snooper_position[i].x = lerpf(previous->snooper_position[i].x, snoopers->position[i].x, alpha);
+		out->snooper_position[i].y = lerpf(previous->snooper_position[i].y, snoopers->position[i].y, alpha);
+		out->snooper_head_rotation_z[i] = angle_lerp(previous->snooper_head_rotation_z[i], snoopers->head_rotation_z[i], alpha);
+		out->snooper_feet_rotation_z[i] = angle_lerp(previous->snooper_feet_rotation_z[i], snoopers->feet_rotation_z[i], alpha);
+		out->snooper_animation_progress[i] = lerp_wrapped(previous->snooper_animation_progress[i], snoopers->animation_progress[i], alpha);
+	}
+
+	for (uint8_t i = 0; i < game_state.level->light_count; i++) {
+		out->light_position[i].x = lerpf(previous->light_position[i].x, game_state.light_states[i].position.x, alpha);
+		out->light_position[i].y = lerpf(previous->light_position[i].y, game_state.light_states[i].position.y, alpha);
+	}
+}
+
+static uint16_t light_grid_entries(const level_t *level) {
+	uint16_t entries = 0;
+	for (uint8_t i = 0; i < level->light_count; i++) {
+		entries += grid_disk_max_cells(0.8f * level->lights[i].radius);
+	}
+	return entries;
+}
+
+static void alloc_level_state(const level_t *level) {
+	arena_reset(&level_arena);
+
+	assertf(level->max_spooker_count >= 1, "Levels need a spooker.");
+	alloc_snooper_pool(&game_state.snoopers, level->max_snooper_count);
+
+	game_state.spookers = ARENA_ALLOC_ARRAY(&level_arena, spooker_state_t, level->max_spooker_count);
+	memset(game_state.spookers, 0, level->max_spooker_count*sizeof(spooker_state_t));
+
+	game_state.light_states = ARENA_ALLOC_ARRAY(&level_arena, level_light_state_t, level->light_count);
+
+	grid_init(&snooper_grid, level, level->max_snooper_count, &level_arena);
+	grid_init(&light_grid, level, light_grid_entries(level), &level_arena);
+
+	state_snapshot_alloc(&game_state.previous, level, &level_arena);
+
+	path_set_graph(level->path_graph, &level_arena);
+}
+
+// Most alloc_level_state and render_load_level can take, keep it in step with them.
+static size_t level_arena_size(const level_t *level) {
+	return snooper_pool_arena_size(level->max_snooper_count)
+		+ ARENA_ARRAY_SIZE(spooker_state_t, level->max_spooker_count)
+		+ ARENA_ARRAY_SIZE(level_light_state_t, level->light_count)
+		+ grid_arena_size(level, level->max_snooper_count)
+		+ grid_arena_size(level, light_grid_entries(level))
+		+ state_snapshot_arena_size(level)
+		+ path_graph_arena_size(level->path_graph)
+		+ render_level_arena_size(level);
+}
+
 void load_level(uint16_t level_index) {
 	game_state.level_index = level_index;
 	game_state.level = levels[level_index];
@@ -43,16 +211,17 @@ void load_level(uint16_t level_index) {
 		return;
 	}
 
+	alloc_level_state(game_state.level);
+
 	game_state.spooker_count = 1;
 	game_state.spookers[0].transform.position.x = 0.f;
 	game_state.spookers[0].transform.position.y = 0.f;
 	game_state.spookers[0].transform.position.z = 0.f;
-	game_state.spookers[0].transform.rotation_z = 0.f;
+	game_state.spookers[0].transform.rotation_z = 0;
 	game_state.spookers[0].velocity.x = 0.f;
 	game_state.spookers[0].velocity.y = 0.f;
 	game_state.spookers[0].knockback_timer = 0;
 
-	game_state.snooper_count = 0;
 
 	game_state.camera_position.x = 0.f;
 	game_state.camera_position.y = CAMERA_OFFSET_Y;
@@ -66,7 +235,13 @@ void load_level(uint16_t level_index) {
 	game_state.status = GAME_STATUS_START;
 	game_state.game_status_timer = 0;
 
-	path_set_graph(game_state.level->path_graph);
+	uint32_t trace_start = TICKS_READ();
+	render_load_level(game_state.level, &level_arena);
+	trace_record(TRACE_LOAD_LEVEL, trace_start, TICKS_READ());
+	if (profile_enabled()) {
+		fprintf(stderr, "level arena: %u of %u bytes used, %u at most\n",
+			(unsigned)level_arena.used, (unsigned)level_arena.size, (unsigned)level_arena.peak);
+	}
 
 	for (int i = 0; i < game_state.level->light_count; i++) {
 		game_state.light_states[i].position = game_state.level->lights[i].position;
@@ -88,31 +263,71 @@ void load_level(uint16_t level_index) {
 		}
 	}
 
+	// Nothing to interpolate from yet.
+	capture_snapshot(&game_state.previous);
+
 	sfx_level_start();
 }
 
 void state_init() {
+	size_t arena_size = 0;
+	for (const level_t **level = levels; *level != NULL; level++) {
+		size_t size = level_arena_size(*level);
+		if (size > arena_size) arena_size = size;
+	}
+	arena_init(&level_arena, memalign(16, arena_size), arena_size);
 	load_level(0);
 }
 
+snooper_handle_t snooper_handle(uint16_t slot) {
+	return ((snooper_handle_t)game_state.snoopers.generation[slot] << 16) | slot;
+}
+
+int snooper_slot(snooper_handle_t handle) {
+	if (handle == SNOOPER_HANDLE_NONE) return -1;
+
+	const snooper_pool_t *snoopers = &game_state.snoopers;
+	uint16_t slot = handle & 0xffff;
+	if (slot >= snoopers->slot_limit) return -1;
+	if (snoopers->generation[slot] != handle >> 16) return -1;
+	if (snoopers->status[slot] == SNOOPER_STATUS_DEAD) return -1;
+	return slot;
+}
+
+static void free_snooper(uint16_t slot) {
+	snooper_pool_t *snoopers = &game_state.snoopers;
+	snoopers->status[slot] = SNOOPER_STATUS_DEAD;
+	snoopers->generation[slot]++;
+	snoopers->free_slots[snoopers->free_count++] = slot;
+	snoopers->count--;
+}
+
 static void spawn_snooper() {
-	if (game_state.snooper_count < MAX_SNOOPER_COUNT) {
-		snooper_state_t *new_snooper = &game_state.snoopers[game_state.snooper_count++];
+	snooper_pool_t *snoopers = &game_state.snoopers;
+	if (snoopers->count < snoopers->capacity) {
+		uint16_t i = snoopers->free_count > 0 ? snoopers->free_slots[--snoopers->free_count] : snoopers->slot_limit++;
+		snoopers->count++;
 
-		new_snooper->status = SNOOPER_STATUS_ALIVE;
+		snoopers->status[i] = SNOOPER_STATUS_ALIVE;
 
-		path_follower_init(&new_snooper->path_follower);
-		new_snooper->position = new_snooper->path_follower.position;
+		path_follower_init(&snoopers->path_follower[i]);
+		snoopers->position[i] = snoopers->path_follower[i].position;
 
-		new_snooper->feet_rotation_z = M_PI;
-		new_snooper->head_rotation_z = M_PI;
+		snoopers->feet_rotation_z[i] = ANGLE_HALF;
+		snoopers->head_rotation_z[i] = ANGLE_HALF;
 
-		new_snooper->rotate_timer = 1;
-		new_snooper->freeze_timer = 0;
+		snoopers->rotate_timer[i] = 1;
+		snoopers->freeze_timer[i] = 0;
 
-		new_snooper->light_brightness = 0;
-		new_snooper->animation_progress = 0.f;
-		new_snooper->spooked_timer = 0;
+		snoopers->light_brightness[i] = 0;
+		snoopers->animation_progress[i] = 0.f;
+		snoopers->spooked_timer[i] = 0;
+
+		// Don't slide in from wherever the slot's last snooper was.
+		game_state.previous.snooper_position[i] = snoopers->position[i];
+		game_state.previous.snooper_head_rotation_z[i] = snoopers->head_rotation_z[i];
+		game_state.previous.snooper_feet_rotation_z[i] = snoopers->feet_rotation_z[i];
+		game_state.previous.snooper_animation_progress[i] = snoopers->animation_progress[i];
 
 		int min_duration = game_state.level->min_snooper_spawn_duration;
 		int max_duration = game_state.level->max_snooper_spawn_duration;
@@ -137,41 +352,81 @@ bool is_wall(float x, float y) {
 	return game_state.level->data[game_state.level->width*grid_y + grid_x] != 1;
 }
 
-static size_t get_light_at(float x, float y, vector2_t *out) {
-	// If we're inside a wall, there's no light.
-	if (is_wall(x, y)) return MAX_SNOOPER_COUNT+1;
+// Binned once per update after the snoopers move, nothing the
+// queries below look at moves between that and the spook.
+static void bin_entities() {
+	grid_clear(&snooper_grid);
+	const snooper_pool_t *snoopers = &game_state.snoopers;
+	for (uint16_t i = 0; i < snoopers->slot_limit; i++) {
+		if (snoopers->status[i] != SNOOPER_STATUS_ALIVE) continue;
+		grid_add_point(&snooper_grid, i, snoopers->position[i].x, snoopers->position[i].y);
+	}
+	grid_finish(&snooper_grid);
 
-	for (size_t i = 0; i < game_state.snooper_count; i++) {
-		snooper_state_t *snooper = game_state.snoopers + i;
-		if (snooper->status != SNOOPER_STATUS_ALIVE) {
-			continue;
-		}
-		float dx = x - snooper->position.x;
-		float dy = y - snooper->position.y;
+	grid_clear(&light_grid);
+	for (uint8_t i = 0; i < game_state.level->light_count; i++) {
+		const level_light_state_t *light_state = &game_state.light_states[i];
+		if (!light_state->is_on) continue;
+		float hit_radius = 0.8f * game_state.level->lights[i].radius;
+		grid_add_disk(&light_grid, i, light_state->position.x, light_state->position.y, hit_radius);
+	}
+	grid_finish(&light_grid);
+}
 
-		float dist2 = dx*dx + dy*dy;
-		if (dist2 > SNOOPER_LIGHT_MAX_DIST*SNOOPER_LIGHT_MAX_DIST) continue;
-		if (dist2 < SNOOPER_LIGHT_MIN_DIST*SNOOPER_LIGHT_MIN_DIST) continue;
-
-		float angle = atan2f(dx, dy);
-		float angle_diff = angle - snooper->head_rotation_z;
-		if (angle_diff < -M_PI) {
-			angle_diff += 2.f*M_PI;
-		} else if (angle_diff > M_PI) {
-			angle_diff -= 2.f*M_PI;
-		}
-		if (angle_diff < 0.5f*SNOOPER_LIGHT_ANGLE && angle_diff > -0.5f*SNOOPER_LIGHT_ANGLE) {
-			float dist = sqrtf(dist2);
-			out->x = dx / dist;
-			out->y = dy / dist;
-			return i;
+// Lowest slot snooper whose light cone covers the point, or -1.
+static int find_snooper_light(float x, float y, vector2_t *out) {
+	grid_range_t range;
+	grid_range(&snooper_grid, x, y, SNOOPER_LIGHT_MAX_DIST, &range);
+
+	float cone_cos = angle_cos(SNOOPER_LIGHT_ANGLE / 2);
+	float cone_cos2 = cone_cos*cone_cos;
+
+	int found = -1;
+	for (int row = range.min_row; row <= range.max_row; row++) {
+		for (int column = range.min_column; column <= range.max_column; column++) {
+			uint16_t count;
+			const uint16_t *items = grid_cell_items(&snooper_grid, column, row, &count);
+			for (uint16_t k = 0; k < count; k++) {
+				int i = items[k];
+				if (found >= 0 && i > found) continue;
+
+				const snooper_pool_t *snoopers = &game_state.snoopers;
+				float dx = x - snoopers->position[i].x;
+				float dy = y - snoopers->position[i].y;
+
+				float dist2 = dx*dx + dy*dy;
+				if (dist2 > SNOOPER_LIGHT_MAX_DIST*SNOOPER_LIGHT_MAX_DIST) continue;
+				if (dist2 < SNOOPER_LIGHT_MIN_DIST*SNOOPER_LIGHT_MIN_DIST) continue;
+
+				// Inside the cone when the angle to the head direction is under half the cone,
+				// compared as cosines so there's no atan2f or sqrtf unless it hits.
+				float facing = dx*angle_sin(snoopers->head_rotation_z[i]) + dy*angle_cos(snoopers->head_rotation_z[i]);
+				if (facing > 0.f && facing*facing > cone_cos2*dist2) {
+					float dist = sqrtf(dist2);
+					out->x = dx / dist;
+					out->y = dy / dist;
+					found = i;
+				}
+			}
 		}
 	}
+	return found;
+}
 
-	for (size_t i = 0; i < game_state.level->light_count; i++) {
-		const level_light_state_t *light_state = &game_state.light_states[i];
-		if (!light_state->is_on) continue;
+// Lowest index level light covering the point, or -1.
+// Lights are binned into every cell they reach so only the point's cell is checked.
+static int find_level_light(float x, float y, vector2_t *out) {
+	grid_range_t range;
+	grid_range(&light_grid, x, y, 0.f, &range);
+
+	uint16_t count;
+	const uint16_t *items = grid_cell_items(&light_grid, range.min_column, range.min_row, &count);
+	int found = -1;
+	for (uint16_t k = 0; k < count; k++) {
+		int i = items[k];
+		if (found >= 0 && i > found) continue;
 
+		const level_light_state_t *light_state = &game_state.light_states[i];
 		const level_light_t *light = &game_state.level->lights[i];
 
 		float dx = x - light_state->position.x;
@@ -189,28 +444,35 @@ static size_t get_light_at(float x, float y, vector2_t *out) {
 			out->x = dx / dist;
 			out->y = dy / dist;
 		}
-		return MAX_SNOOPER_COUNT;
+		found = i;
 	}
-
-	return MAX_SNOOPER_COUNT+1;
+	return found;
 }
 
-float step_to_angle(float cur, float target) {
-	float diff = target - cur;
-	// Normalize diff to [-pi, pi]
-	if (diff < -M_PI) {
-		diff += 2.f*M_PI;
-	} else if (diff > M_PI) {
-		diff -= 2.f*M_PI;
+typedef enum {
+	LIGHT_HIT_NONE=0,
+	LIGHT_HIT_SNOOPER=1,
+	LIGHT_HIT_LEVEL=2,
+} light_hit_t;
+
+// Which light, if any, is shining on the point. The snooper is set for snooper hits only.
+static light_hit_t get_light_at(float x, float y, vector2_t *out, snooper_handle_t *snooper) {
+	*snooper = SNOOPER_HANDLE_NONE;
+
+	// If we're inside a wall, there's no light.
+	if (is_wall(x, y)) return LIGHT_HIT_NONE;
+
+	int slot = find_snooper_light(x, y, out);
+	if (slot >= 0) {
+		*snooper = snooper_handle(slot);
+		return LIGHT_HIT_SNOOPER;
 	}
 
-	float res = cur + diff / 4.f;
-	if (res < -M_PI) {
-		res += 2.f*M_PI;
-	} else if (res > M_PI) {
-		res -= 2.f*M_PI;
+	if (find_level_light(x, y, out) >= 0) {
+		return LIGHT_HIT_LEVEL;
 	}
-	return res;
+
+	return LIGHT_HIT_NONE;
 }
 
 
@@ -228,9 +490,20 @@ void state_update() {
 		return;
 	}
 
+	capture_snapshot(&game_state.previous);
+
 	controller_scan();
 	struct controller_data ckeys = get_keys_held();
 
+	// Debug toggle for the painter's order renderer.
+	struct controller_data pressed = get_keys_down();
+	if (pressed.c[0].L) render_toggle_painter_mode();
+	// Frame profiler overlay and log.
+	if (pressed.c[0].R) profile_toggle();
+	// Timeline of the last few thousand scopes, see tools/trace2json.py.
+	if (pressed.c[0].down) trace_dump();
+	if (pressed.c[0].up) render_toggle_dynamic_resolution();
+
 	// Update status timer.
 	if (game_state.status == GAME_STATUS_LOSE || game_state.status == GAME_STATUS_WIN) {
 		if (ckeys.c[0].start || game_state.game_status_timer > 0) {
@@ -274,145 +547,132 @@ void state_update() {
 
 	// Spawn snooper?
 	if (game_state.snooper_timer > 0) game_state.snooper_timer--;
-	if (game_state.snooper_count == 0 || game_state.snooper_timer == 0) {
+	if (game_state.snoopers.count == 0 || game_state.snooper_timer == 0) {
 		spawn_snooper();
 	}
 
 	// Move snoopers
-	for (uint16_t i = 0; i < game_state.snooper_count; i++) {
-		snooper_state_t *snooper = game_state.snoopers + i;
+	snooper_pool_t *snoopers = &game_state.snoopers;
+	for (uint16_t i = 0; i < snoopers->slot_limit; i++) {
+		if (snoopers->status[i] == SNOOPER_STATUS_DEAD) continue;
 
-		if (snooper->status == SNOOPER_STATUS_DYING) {
-			if (++snooper->freeze_timer == SNOOPER_DIE_DURATION) {
-				snooper->status = SNOOPER_STATUS_DEAD;
+		if (snoopers->status[i] == SNOOPER_STATUS_DYING) {
+			if (++snoopers->freeze_timer[i] == SNOOPER_DIE_DURATION) {
+				free_snooper(i);
 				sfx_bad();
 				game_state.snooper_death_count++;
 			}
-			snooper->position.y -= SNOOPER_SPEED;
+			snoopers->position[i].y -= SNOOPER_SPEED;
 
 			continue;
 		}
 
-		update_light_brightness(&snooper->light_brightness);
+		update_light_brightness(&snoopers->light_brightness[i]);
 
-		float speed = snooper->status == SNOOPER_STATUS_ALIVE ? SNOOPER_SPEED : -SNOOPER_RUN_SPEED;
-		float animation_speed = snooper->status == SNOOPER_STATUS_ALIVE ? 0.05f : 0.15f;
-		if (snooper->freeze_timer != 0) {
+		float speed = snoopers->status[i] == SNOOPER_STATUS_ALIVE ? SNOOPER_SPEED : -SNOOPER_RUN_SPEED;
+		float animation_speed = snoopers->status[i] == SNOOPER_STATUS_ALIVE ? 0.05f : 0.15f;
+		if (snoopers->freeze_timer[i] != 0) {
 			// TODO : animation?
 			speed *= 0.5f;
 			animation_speed *= 0.5f;
 		}
 
-		snooper->animation_progress += animation_speed;
-		if (snooper->animation_progress >= 1.f) {
-			snooper->animation_progress = 0.f;
+		snoopers->animation_progress[i] += animation_speed;
+		if (snoopers->animation_progress[i] >= 1.f) {
+			snoopers->animation_progress[i] = 0.f;
 		}
 
-		bool end = path_follow(&snooper->path_follower, speed);
+		bool end = path_follow(&snoopers->path_follower[i], speed);
 
 		if (end) {
-			if (snooper->status == SNOOPER_STATUS_ALIVE) {
+			if (snoopers->status[i] == SNOOPER_STATUS_ALIVE) {
 				sfx_snooper_die();
-				snooper->status = SNOOPER_STATUS_DYING;
-				snooper->freeze_timer = 0;
-			} else if (snooper->status == SNOOPER_STATUS_SPOOKED) {
+				snoopers->status[i] = SNOOPER_STATUS_DYING;
+				snoopers->freeze_timer[i] = 0;
+			} else if (snoopers->status[i] == SNOOPER_STATUS_SPOOKED) {
 				sfx_point();
 				game_state.score++;
-				snooper->status = SNOOPER_STATUS_DEAD;
+				free_snooper(i);
 			}
 			continue;
 		}
-		float dx = snooper->path_follower.position.x - snooper->position.x;
-		float dy = snooper->path_follower.position.y - snooper->position.y;
+		float dx = snoopers->path_follower[i].position.x - snoopers->position[i].x;
+		float dy = snoopers->path_follower[i].position.y - snoopers->position[i].y;
 		if (dx != 0.f || dy != 0.f) {
-			snooper->feet_rotation_z = atan2f(dx, dy);
+			snoopers->feet_rotation_z[i] = angle_atan2(dx, dy);
 		}
-		float smoothness = snooper->status == SNOOPER_STATUS_ALIVE ? 0.9f : 0.8f;
+		float smoothness = snoopers->status[i] == SNOOPER_STATUS_ALIVE ? 0.9f : 0.8f;
 		float roughness = 1.f - smoothness;
-		snooper->position.x = smoothness * snooper->position.x + roughness * snooper->path_follower.position.x;
-		snooper->position.y = smoothness * snooper->position.y + roughness * snooper->path_follower.position.y;
+		snoopers->position[i].x = smoothness * snoopers->position[i].x + roughness * snoopers->path_follower[i].position.x;
+		snoopers->position[i].y = smoothness * snoopers->position[i].y + roughness * snoopers->path_follower[i].position.y;
 
-		if (snooper->freeze_timer == 0) {
-			if (snooper->status == SNOOPER_STATUS_SPOOKED) {
-				snooper->spooked_timer++;
+		if (snoopers->freeze_timer[i] == 0) {
+			if (snoopers->status[i] == SNOOPER_STATUS_SPOOKED) {
+				snoopers->spooked_timer[i]++;
 			}
-			if (snooper->status == SNOOPER_STATUS_ALIVE) {
-				if (--snooper->rotate_timer == 0) {
-					snooper->rotate_timer = 20 + RANDN(60);
-					float target_rotation_z = snooper->feet_rotation_z + (M_PI/3.0f)*(randf()-0.5f);
-					if (target_rotation_z < -M_PI) {
-						target_rotation_z += 2.f*M_PI;
-					} else if (target_rotation_z > M_PI) {
-						target_rotation_z -= 2.f*M_PI;
-					}
-					snooper->head_target_rotation_z = target_rotation_z;
+			if (snoopers->status[i] == SNOOPER_STATUS_ALIVE) {
+				if (--snoopers->rotate_timer[i] == 0) {
+					snoopers->rotate_timer[i] = 20 + RANDN(60);
+					angle_diff_t wander = (angle_diff_t)(SNOOPER_HEAD_WANDER*(randf()-0.5f));
+					snoopers->head_target_rotation_z[i] = snoopers->feet_rotation_z[i] + wander;
 				}
 			} else {
-				snooper->head_target_rotation_z = snooper->feet_rotation_z;
+				snoopers->head_target_rotation_z[i] = snoopers->feet_rotation_z[i];
 			}
 		} else {
-			snooper->freeze_timer--;
+			snoopers->freeze_timer[i]--;
 
-			if (snooper->status == SNOOPER_STATUS_ALIVE) {
+			if (snoopers->status[i] == SNOOPER_STATUS_ALIVE) {
 				// Look at spooker if nearby and being knocked back.
 				if (game_state.spookers[0].knockback_timer >= SPOOKER_KNOCKBACK_THRESHOLD) {
 					vector3_t *spooker_pos = &game_state.spookers[0].transform.position;
-					vector2_t *snooper_pos = &snooper->position;
+					vector2_t *snooper_pos = &snoopers->position[i];
 					float dx = spooker_pos->x - snooper_pos->x;
 					float dy = spooker_pos->y - snooper_pos->y;
 
 					if (dx*dx + dy*dy < SNOOPER_LOOK_DIST*SNOOPER_LOOK_DIST) {
-						snooper->head_target_rotation_z = atan2f(dx, dy);
+						snoopers->head_target_rotation_z[i] = angle_atan2(dx, dy);
 					}
 				}
-			} else if (snooper->status == SNOOPER_STATUS_SPOOKED) {
-				if (snooper->freeze_timer == 0) {
+			} else if (snoopers->status[i] == SNOOPER_STATUS_SPOOKED) {
+				if (snoopers->freeze_timer[i] == 0) {
 					sfx_snooper_scream();
 				}
 			}
 		}
 
-		snooper->head_rotation_z = step_to_angle(snooper->head_rotation_z, snooper->head_target_rotation_z);
+		snoopers->head_rotation_z[i] = angle_step_to(snoopers->head_rotation_z[i], snoopers->head_target_rotation_z[i]);
 	}
 
-	// Remove killed snoopers
-	{
-		uint16_t i = 0;
-		uint16_t j = 0;
-		while (j < game_state.snooper_count) {
-			if (game_state.snoopers[j].status == SNOOPER_STATUS_DEAD) {
-				j++;
-			} else {
-				if (i != j) {
-					game_state.snoopers[i] = game_state.snoopers[j];
-				}
-				i++;
-				j++;
-			}
-		}
-		game_state.snooper_count = i;
-	}
+	bin_entities();
 
 	// Move spooker
 	{
 		spooker_state_t *spooker = game_state.spookers;
 
 		if (spooker->knockback_timer == 0) {
-			vector2_t light_direction;
-			size_t snooper_light_index = get_light_at(
+			vector2_t light_direction = {0.f, 0.f};
+			snooper_handle_t lit_by;
+			light_hit_t hit = get_light_at(
 					spooker->transform.position.x,
 					spooker->transform.position.y,
-					&light_direction);
+					&light_direction,
+					&lit_by);
 
-			if (snooper_light_index < MAX_SNOOPER_COUNT+1) {
+			if (hit != LIGHT_HIT_NONE) {
 				sfx_spooker_oof();
-				if (snooper_light_index < MAX_SNOOPER_COUNT) sfx_snooper_speak();
+				if (hit == LIGHT_HIT_SNOOPER) sfx_snooper_speak();
 				spooker->velocity.x = 0.5f * light_direction.x;
 				spooker->velocity.y = 0.5f * light_direction.y;
 				spooker->knockback_timer = SPOOKER_KNOCKBACK_THRESHOLD + SPOOKER_KNOCKBACK_DURATION;
 				spooker->spook_timer = 0;
-				game_state.snoopers[snooper_light_index].freeze_timer = 120;
-				game_state.snoopers[snooper_light_index].rotate_timer = 1;
+
+				// Level lights have no snooper to freeze.
+				int slot = snooper_slot(lit_by);
+				if (slot >= 0) {
+					game_state.snoopers.freeze_timer[slot] = 120;
+					game_state.snoopers.rotate_timer[slot] = 1;
+				}
 			}
 		}
 
@@ -439,26 +699,27 @@ void state_update() {
 
 			spooker->velocity.x = (spooker->velocity.x + dx) / 2.f;
 			spooker->velocity.y = (spooker->velocity.y + dy) / 2.f;
+			// Halving on its own would go denormal, stop once it's far too small to matter.
+			if (fabsf(spooker->velocity.x) + fabsf(spooker->velocity.y) < SPOOKER_STOP_SPEED) {
+				spooker->velocity.x = 0.f;
+				spooker->velocity.y = 0.f;
+			}
 
 			if (spooker->velocity.x != 0 || spooker->velocity.y != 0) {
 				spooker->transform.position.x += spooker->velocity.x;
 				spooker->transform.position.y += spooker->velocity.y;
 
-				float target_angle = atan2f(spooker->velocity.x, spooker->velocity.y);
-				spooker->transform.rotation_z = step_to_angle(spooker->transform.rotation_z, target_angle);
+				angle_t target_angle = angle_atan2(spooker->velocity.x, spooker->velocity.y);
+				spooker->transform.rotation_z = angle_step_to(spooker->transform.rotation_z, target_angle);
 			}
 		} else {
 			// knockback
 			spooker->transform.position.x += spooker->velocity.x;
 			spooker->transform.position.y += spooker->velocity.y;
-			spooker->transform.rotation_z += 0.02f * (spooker->knockback_timer - SPOOKER_KNOCKBACK_THRESHOLD);
+			spooker->transform.rotation_z += SPOOKER_KNOCKBACK_SPIN * (spooker->knockback_timer - SPOOKER_KNOCKBACK_THRESHOLD);
 
 			spooker->velocity.x *= 0.92f;
 			spooker->velocity.y *= 0.92f;
-
-			if (spooker->transform.rotation_z > M_PI) {
-				spooker->transform.rotation_z -= 2.f*M_PI;
-			}
 		}
 
 		if (spooker->knockback_timer != 0) spooker->knockback_timer--;
@@ -488,17 +749,26 @@ void state_update() {
 			sfx_spooker_spook_muffled();
 		} else {
 			sfx_spooker_spook();
-			for (uint16_t i = 0; i < game_state.snooper_count; i++) {
-				if (game_state.snoopers[i].status != SNOOPER_STATUS_ALIVE) {
-					continue;
-				}
-				float dx = game_state.snoopers[i].position.x - game_state.spookers[0].transform.position.x;
-				float dy = game_state.snoopers[i].position.y - game_state.spookers[0].transform.position.y;
-				float dist2 = dx*dx + dy*dy;
-				if (dist2 < SPOOK_DISTANCE*SPOOK_DISTANCE) {
-					game_state.snoopers[i].status = SNOOPER_STATUS_SPOOKED;
-					game_state.snoopers[i].freeze_timer = 5;
-					game_state.snoopers[i].spooked_timer = 0;
+			float spook_x = game_state.spookers[0].transform.position.x;
+			float spook_y = game_state.spookers[0].transform.position.y;
+			grid_range_t range;
+			grid_range(&snooper_grid, spook_x, spook_y, SPOOK_DISTANCE, &range);
+			for (int row = range.min_row; row <= range.max_row; row++) {
+				for (int column = range.min_column; column <= range.max_column; column++) {
+					uint16_t count;
+					const uint16_t *items = grid_cell_items(&snooper_grid, column, row, &count);
+					for (uint16_t k = 0; k < count; k++) {
+						uint16_t i = items[k];
+						snooper_pool_t *snoopers = &game_state.snoopers;
+						float dx = snoopers->position[i].x - spook_x;
+						float dy = snoopers->position[i].y - spook_y;
+						float dist2 = dx*dx + dy*dy;
+						if (dist2 < SPOOK_DISTANCE*SPOOK_DISTANCE) {
+							snoopers->status[i] = SNOOPER_STATUS_SPOOKED;
+							snoopers->freeze_timer[i] = 5;
+							snoopers->spooked_timer[i] = 0;
+						}
+					}
 				}
 			}
 		}
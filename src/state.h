@@ -4,10 +4,8 @@
 #include "render.h"
 #include "level.h"
 #include "path.h"
+#include "arena.h"
 
-#define MAX_SNOOPER_COUNT 32
-#define MAX_SPOOKER_COUNT 4
-#define MAX_LEVEL_LIGHT_COUNT 32
 #define SNOOPER_DIE_DURATION 20
 #define GAME_START_DURATION 90
 #define GAME_END_DURATION 20
@@ -30,19 +28,42 @@ typedef enum {
 	GAME_STATUS_BEAT=5,
 } game_status_t;
 
+// Snoopers live in fixed slots that never move, one array per field.
+// The arrays hold the level's max_snooper_count and come from the level arena.
+// A slot is free while its status is SNOOPER_STATUS_DEAD.
 typedef struct {
-	vector2_t position;
-	float feet_rotation_z;
-	float head_rotation_z;
-	float head_target_rotation_z;
-	path_follower_t path_follower;
-	uint16_t rotate_timer;
-	uint16_t freeze_timer;
-	uint16_t light_brightness;
-	uint16_t spooked_timer;
-	float animation_progress;
-	snooper_status_t status;
-} snooper_state_t;
+	// Read every frame by the update, the light queries and the renderer.
+	snooper_status_t *status;
+	vector2_t *position;
+	angle_t *head_rotation_z;
+	angle_t *feet_rotation_z;
+	uint16_t *freeze_timer;
+	float *animation_progress;
+	uint16_t *light_brightness;
+
+	// Only touched by the update.
+	angle_t *head_target_rotation_z;
+	uint16_t *rotate_timer;
+	uint16_t *spooked_timer;
+	path_follower_t *path_follower;
+
+	// Bumped whenever a slot is freed, so handles to the old snooper stop resolving.
+	uint8_t *generation;
+
+	// Freed slots, reused last in first out before slot_limit grows.
+	uint16_t *free_slots;
+	uint16_t free_count;
+	// Every slot at or past this has never been used, loops stop here.
+	uint16_t slot_limit;
+	uint16_t capacity;
+	// Snoopers that aren't dead.
+	uint16_t count;
+} snooper_pool_t;
+
+// Generation in the high half, slot in the low half.
+// Generations are 8 bit, so no handle is ever SNOOPER_HANDLE_NONE.
+typedef uint32_t snooper_handle_t;
+#define SNOOPER_HANDLE_NONE 0xffffffff
 
 typedef struct {
 	object_transform_t transform;
@@ -71,14 +92,26 @@ typedef struct {
 	level_light_type_state_t type_state;
 } level_light_state_t;
 
+// Everything the renderer moves smoothly, one tick's worth.
+// Arrays are sized like the ones in game_state_t they copy.
+typedef struct {
+	vector3_t camera_position;
+	object_transform_t *spookers;
+	vector2_t *snooper_position;
+	angle_t *snooper_head_rotation_z;
+	angle_t *snooper_feet_rotation_z;
+	float *snooper_animation_progress;
+	vector2_t *light_position;
+} state_snapshot_t;
+
 typedef struct {
-	uint16_t snooper_count;
 	uint16_t spooker_count;
 
-	snooper_state_t snoopers[MAX_SNOOPER_COUNT];
-	spooker_state_t spookers[MAX_SPOOKER_COUNT];
+	// Sized by the level, see load_level.
+	snooper_pool_t snoopers;
+	spooker_state_t *spookers;
 
-	level_light_state_t light_states[MAX_LEVEL_LIGHT_COUNT];
+	level_light_state_t *light_states;
 
 	vector3_t camera_position;
 
@@ -92,6 +125,9 @@ typedef struct {
 
 	uint16_t level_index;
 	const level_t *level;
+
+	// Transforms from before the last state_update, for render interpolation.
+	state_snapshot_t previous;
 } game_state_t;
 
 
@@ -99,4 +135,13 @@ extern game_state_t game_state;
 void state_init();
 void state_update();
 
+void state_snapshot_alloc(state_snapshot_t *snapshot, const level_t *level, arena_t *arena);
+size_t state_snapshot_arena_size(const level_t *level);
+// Transforms alpha of the way from the previous tick to the current one.
+void state_interpolate(state_snapshot_t *out, float alpha);
+
+snooper_handle_t snooper_handle(uint16_t slot);
+// Slot of a live snooper, or -1 if it has died since the handle was made.
+int snooper_slot(snooper_handle_t handle);
+
 #endif
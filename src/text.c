@@ -0,0 +1,60 @@
+#include "text.h"
+#include <string.h>
+#include "tmem.h"
+
+#define TEXT_GLYPH_SIZE 8
+
+// Labels are loaded into TMEM one slice at a time.
+#define TEXT_SLICE_WIDTH 64
+#define TEXT_LABEL_WIDTH (TEXT_GLYPH_SIZE*TEXT_LABEL_MAX_LENGTH)
+
+void text_label_init(text_label_t *label) {
+	label->surface = surface_alloc(FMT_RGBA16, TEXT_LABEL_WIDTH, TEXT_GLYPH_SIZE);
+	memset(label->surface.buffer, 0, label->surface.stride * TEXT_GLYPH_SIZE);
+
+	label->sprite.width = TEXT_LABEL_WIDTH;
+	label->sprite.height = TEXT_GLYPH_SIZE;
+	label->sprite.flags = SPRITE_FLAGS_EXT | FMT_RGBA16;
+	label->sprite.hslices = TEXT_LABEL_WIDTH / TEXT_SLICE_WIDTH;
+	label->sprite.vslices = 1;
+
+	label->width = 0;
+}
+
+void text_label_set(text_label_t *label, const char *text) {
+	// The RDP may still be reading the old text.
+	rspq_wait();
+	tmem_invalidate();
+
+	memset(label->surface.buffer, 0, label->surface.stride * TEXT_GLYPH_SIZE);
+
+	char clipped[TEXT_LABEL_MAX_LENGTH + 1];
+	strncpy(clipped, text, TEXT_LABEL_MAX_LENGTH);
+	clipped[TEXT_LABEL_MAX_LENGTH] = '\0';
+
+	// White on a transparent background, the color comes from prim when drawing.
+	graphics_set_color(graphics_make_color(0xff, 0xff, 0xff, 0xff), 0);
+	graphics_draw_text(&label->surface, 0, 0, clipped);
+
+	label->width = strlen(clipped) * TEXT_GLYPH_SIZE;
+}
+
+void text_set_mode() {
+	rdpq_set_mode_standard();
+	rdpq_mode_combiner(RDPQ_COMBINER1((TEX0, 0, PRIM, 0), (TEX0, 0, PRIM, 0)));
+	rdpq_mode_blender(RDPQ_BLENDER((IN_RGB, IN_ALPHA, MEMORY_RGB, INV_MUX_ALPHA)));
+}
+
+void text_label_draw(const text_label_t *label, int x, int y, uint8_t brightness) {
+	if (label->width == 0) return;
+
+	rdpq_set_prim_color(RGBA32(brightness, brightness, brightness, 0xff));
+
+	// Only the slices with text in them.
+	int slice_count = (label->width + TEXT_SLICE_WIDTH - 1) / TEXT_SLICE_WIDTH;
+	for (int slice = 0; slice < slice_count; slice++) {
+		int s = slice * TEXT_SLICE_WIDTH;
+		tmem_load((sprite_t *)&label->sprite, label->surface.buffer, slice);
+		rdpq_texture_rectangle(0, x + s, y, x + s + TEXT_SLICE_WIDTH, y + TEXT_GLYPH_SIZE, s, 0.f, 1.f, 1.f);
+	}
+}
@@ -0,0 +1,25 @@
+#ifndef SPOOK64_TEXT
+#define SPOOK64_TEXT
+
+#include "dragon.h"
+
+// Longest string a label can hold, in 8x8 font characters.
+#define TEXT_LABEL_MAX_LENGTH 24
+
+// A string rasterized once with the CPU font into its own texture,
+// then drawn every frame with textured rectangles on the RDP.
+typedef struct {
+	surface_t surface;
+	sprite_t sprite;
+	uint16_t width;
+} text_label_t;
+
+void text_label_init(text_label_t *label);
+// Waits for the RDP, so call it at load time rather than every frame.
+void text_label_set(text_label_t *label, const char *text);
+
+// Sets the render mode for text_label_draw.
+void text_set_mode();
+void text_label_draw(const text_label_t *label, int x, int y, uint8_t brightness);
+
+#endif
@@ -0,0 +1,45 @@
+#include "tmem.h"
+#include "libdragon_hax.h"
+
+static const void *resident_buffer;
+static tex_format_t resident_format;
+static int resident_slice;
+
+static uint32_t bytes_loaded;
+static uint32_t loads_skipped;
+
+void tmem_invalidate() {
+	resident_buffer = NULL;
+}
+
+void tmem_load(sprite_t *sprite, void *buffer, int slice) {
+	tex_format_t format = (tex_format_t)(sprite->flags & SPRITE_FLAGS_TEXFORMAT);
+	if (buffer == resident_buffer && format == resident_format && slice == resident_slice) {
+		loads_skipped++;
+		return;
+	}
+
+	rdpq_sync_load();
+	bytes_loaded += rdp_load_texture_stride_hax(0, 0, MIRROR_DISABLED, sprite, buffer, slice);
+
+	resident_buffer = buffer;
+	resident_format = format;
+	resident_slice = slice;
+}
+
+void tmem_load_sprite(sprite_t *sprite) {
+	tmem_load(sprite, sprite->data, 0);
+}
+
+void tmem_reset_stats() {
+	bytes_loaded = 0;
+	loads_skipped = 0;
+}
+
+uint32_t tmem_bytes_loaded() {
+	return bytes_loaded;
+}
+
+uint32_t tmem_loads_skipped() {
+	return loads_skipped;
+}
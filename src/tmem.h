@@ -0,0 +1,20 @@
+#ifndef SPOOK64_TMEM
+#define SPOOK64_TMEM
+
+#include "dragon.h"
+
+// Every texture goes to tile 0 at TMEM address 0, so there's one resident texture.
+// Loads of the texture that's already resident are skipped.
+
+// Call when TMEM was loaded behind our back, e.g. by rdp_load_texture or a block.
+void tmem_invalidate();
+// Loads one slice of sprite, with the texels read from buffer.
+void tmem_load(sprite_t *sprite, void *buffer, int slice);
+void tmem_load_sprite(sprite_t *sprite);
+
+// Counters since the last tmem_reset_stats.
+void tmem_reset_stats();
+uint32_t tmem_bytes_loaded();
+uint32_t tmem_loads_skipped();
+
+#endif
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include "trace.h"
+
+static const char *scope_names[TRACE_SCOPE_COUNT] = {
+	"update",
+	"light",
+	"level",
+	"entities",
+	"hud",
+	"audio",
+	"load_assets",
+	"load_level",
+	"load_screen",
+	"frame",
+};
+
+static trace_event_t events[TRACE_MAX_EVENTS];
+// Total events recorded, the newest is at (event_count - 1) % TRACE_MAX_EVENTS.
+static uint32_t event_count;
+static uint16_t frame;
+
+static void push_event(trace_scope_t scope, uint32_t start, uint32_t duration) {
+	trace_event_t *event = &events[event_count % TRACE_MAX_EVENTS];
+	event->start = start;
+	event->duration = duration;
+	event->frame = frame;
+	event->scope = scope;
+	event_count++;
+}
+
+void trace_record(trace_scope_t scope, uint32_t start, uint32_t end) {
+	uint32_t duration = end - start;
+	if (duration < TRACE_MIN_TICKS) return;
+	push_event(scope, start, duration);
+}
+
+void trace_frame() {
+	frame++;
+	push_event(TRACE_FRAME, TICKS_READ(), 0);
+}
+
+void trace_dump() {
+	uint32_t count = event_count < TRACE_MAX_EVENTS ? event_count : TRACE_MAX_EVENTS;
+	uint32_t first = event_count - count;
+	if (count == 0) return;
+
+	// Times are relative to the oldest event so the 32 bit tick counter wrapping doesn't matter.
+	// Signed, since a scope recorded later can have started earlier.
+	uint32_t base = events[first % TRACE_MAX_EVENTS].start;
+
+	// Not debugf, that's compiled out with NDEBUG.
+	fprintf(stderr, "trace begin %ld %lu\n", (long)TICKS_PER_SECOND, (unsigned long)count);
+	for (uint32_t i = first; i < event_count; i++) {
+		const trace_event_t *event = &events[i % TRACE_MAX_EVENTS];
+		fprintf(stderr, "t %s %ld %lu %u\n",
+			scope_names[event->scope],
+			(long)(int32_t)(event->start - base),
+			(unsigned long)event->duration,
+			event->frame);
+	}
+	fprintf(stderr, "trace end\n");
+}
@@ -0,0 +1,41 @@
+#ifndef SPOOK64_TRACE
+#define SPOOK64_TRACE
+
+#include "dragon.h"
+
+typedef enum {
+	// Same values as profile_phase_t, profile_end records these.
+	TRACE_UPDATE=0,
+	TRACE_LIGHT=1,
+	TRACE_LEVEL=2,
+	TRACE_ENTITIES=3,
+	TRACE_HUD=4,
+	TRACE_AUDIO=5,
+
+	TRACE_LOAD_ASSETS=6,
+	TRACE_LOAD_LEVEL=7,
+	TRACE_LOAD_SCREEN=8,
+	// Instant event at the start of each frame.
+	TRACE_FRAME=9,
+	TRACE_SCOPE_COUNT=10,
+} trace_scope_t;
+
+// Ring buffer size, the oldest events are overwritten.
+#define TRACE_MAX_EVENTS 2048
+// Scopes shorter than this are dropped so polling loops like the audio wait don't flood the buffer.
+#define TRACE_MIN_TICKS (TICKS_PER_SECOND / 200000)
+
+typedef struct {
+	uint32_t start;
+	uint32_t duration;
+	uint16_t frame;
+	uint8_t scope;
+} trace_event_t;
+
+// Records a finished scope, start and end are TICKS_READ values.
+void trace_record(trace_scope_t scope, uint32_t start, uint32_t end);
+void trace_frame();
+// Writes the buffer to stderr, tools/trace2json.py turns it into a Chrome trace.
+void trace_dump();
+
+#endif
@@ -0,0 +1,280 @@
+#include <math.h>
+#include <malloc.h>
+#include "vertex.h"
+
+void vertex_setup_object(object_setup_t *setup, const vertex_camera_t *camera, const vector3_t *relative_position, float sin_yaw, float cos_yaw) {
+	float relative_x = relative_position->x;
+	float relative_y = relative_position->y;
+	float relative_z = relative_position->z;
+
+	setup->x[0] = camera->wx_factor * camera->xx * cos_yaw;
+	setup->x[1] = camera->wx_factor * camera->xx * sin_yaw;
+	setup->x[2] = 0.f;
+	setup->x[3] = camera->wx_factor * camera->xx * relative_x;
+
+	setup->y[0] = camera->wy_factor * -camera->yy * sin_yaw;
+	setup->y[1] = camera->wy_factor * camera->yy * cos_yaw;
+	setup->y[2] = camera->wy_factor * camera->yz;
+	setup->y[3] = camera->wy_factor * (camera->yy * relative_y + camera->yz * relative_z);
+
+	setup->z[0] = -camera->zy * sin_yaw;
+	setup->z[1] = camera->zy * cos_yaw;
+	setup->z[2] = camera->zz;
+	setup->z[3] = camera->zy * relative_y + camera->zz * relative_z;
+
+	const vector3_t *light = &camera->light_direction;
+	setup->light_x = light->x * cos_yaw - light->y * sin_yaw;
+	setup->light_y = light->x * sin_yaw + light->y * cos_yaw;
+	setup->light_z = light->z;
+}
+
+// Anything closer than this is clamped, behind the camera it would divide by zero or overflow.
+#define MIN_FIXED_DEPTH (FIXED_ONE >> 8)
+
+// Rounds, model data is only converted once so there's no point in the cheaper truncation.
+static fixed_t float_to_fixed(float f) {
+	return (fixed_t)floorf(f * FIXED_ONE + 0.5f);
+}
+
+// An int to float conversion and a power of two scale, neither can underflow.
+static inline float fixed_to_float(fixed_t x) {
+	return (float)x * (1.f / FIXED_ONE);
+}
+
+static inline fixed_t fixed_dot4(const fixed_t *row, fixed_t x, fixed_t y, fixed_t z) {
+	int64_t sum = (int64_t)row[0]*x + (int64_t)row[1]*y + (int64_t)row[2]*z;
+	return (fixed_t)(sum >> FIXED_SHIFT) + row[3];
+}
+
+static inline fixed_t fixed_mul(fixed_t a, fixed_t b) {
+	return (fixed_t)(((int64_t)a * b) >> FIXED_SHIFT);
+}
+
+// 1/m for m in [0.5, 1) at the middle of each of 256 steps, in 1.15 so it fits 16 bits.
+// Generated with [round(2**25/(513 + 2*i)) for i in range(256)].
+static const uint16_t reciprocal_seeds[256] = {
+	65408, 65154, 64902, 64652, 64404, 64158, 63913, 63671, 63430, 63191, 62954, 62719,
+	62485, 62253, 62023, 61795, 61568, 61343, 61119, 60897, 60677, 60458, 60241, 60026,
+	59812, 59599, 59388, 59179, 58971, 58764, 58559, 58356, 58153, 57952, 57753, 57555,
+	57358, 57163, 56968, 56776, 56584, 56394, 56205, 56017, 55831, 55646, 55462, 55279,
+	55098, 54917, 54738, 54560, 54383, 54207, 54033, 53859, 53687, 53516, 53346, 53177,
+	53009, 52842, 52676, 52511, 52347, 52184, 52022, 51862, 51702, 51543, 51385, 51228,
+	51072, 50917, 50763, 50610, 50458, 50306, 50156, 50007, 49858, 49710, 49563, 49417,
+	49272, 49128, 48985, 48842, 48700, 48559, 48419, 48280, 48141, 48003, 47867, 47730,
+	47595, 47460, 47326, 47193, 47061, 46929, 46798, 46668, 46539, 46410, 46282, 46155,
+	46028, 45902, 45777, 45652, 45528, 45405, 45283, 45161, 45040, 44919, 44799, 44680,
+	44561, 44443, 44326, 44209, 44093, 43977, 43862, 43748, 43634, 43521, 43408, 43296,
+	43185, 43074, 42963, 42854, 42744, 42636, 42528, 42420, 42313, 42207, 42101, 41996,
+	41891, 41786, 41683, 41579, 41476, 41374, 41272, 41171, 41070, 40970, 40870, 40771,
+	40672, 40574, 40476, 40378, 40281, 40185, 40089, 39993, 39898, 39804, 39709, 39616,
+	39522, 39429, 39337, 39245, 39153, 39062, 38971, 38881, 38791, 38702, 38613, 38524,
+	38436, 38348, 38260, 38173, 38087, 38000, 37915, 37829, 37744, 37659, 37575, 37491,
+	37407, 37324, 37241, 37159, 37077, 36995, 36914, 36833, 36752, 36672, 36592, 36512,
+	36433, 36354, 36275, 36197, 36119, 36041, 35964, 35887, 35810, 35734, 35658, 35583,
+	35507, 35432, 35358, 35283, 35209, 35136, 35062, 34989, 34916, 34844, 34771, 34700,
+	34628, 34557, 34486, 34415, 34344, 34274, 34204, 34135, 34065, 33996, 33928, 33859,
+	33791, 33723, 33655, 33588, 33521, 33454, 33387, 33321, 33255, 33189, 33124, 33059,
+	32994, 32929, 32864, 32800,
+};
+
+// 2^32 / z, which is 1/z in s15.16, for z >= MIN_FIXED_DEPTH.
+// The VR4300 is slow at 64 bit divides, so this is a table seed and one Newton step with 32 bit multiplies.
+static inline fixed_t fixed_reciprocal(fixed_t z) {
+	// Normalize to m in [0.5, 1) as 0.32.
+	int shift = __builtin_clz((uint32_t)z);
+	uint32_t m = (uint32_t)z << shift;
+
+	// r = r*(2 - m*r), in 2.30.
+	uint32_t r = (uint32_t)reciprocal_seeds[(m >> 23) & 0xff] << 15;
+	uint32_t mr = (uint32_t)(((uint64_t)m * r) >> 32);
+	r = (uint32_t)(((uint64_t)r * ((2u << 30) - mr)) >> 30);
+
+	return (fixed_t)(r >> (30 - shift));
+}
+
+static void row_to_fixed(fixed_t *out, const float *row) {
+	for (int i = 0; i < 4; i++) {
+		out[i] = float_to_fixed(row[i]);
+	}
+}
+
+void vertex_project_float(const object_setup_t *setup, const vertex_camera_t *camera, const model_t *model, float *out_positions) {
+	const float *in_positions = model->positions;
+	float *out_pos = out_positions;
+	for (uint16_t i = 0; i < model->positions_len; i += 3) {
+		float in_x = in_positions[i];
+		float in_y = in_positions[i + 1];
+		float in_z = in_positions[i + 2];
+
+		float x2 = setup->x[0]*in_x + setup->x[1]*in_y + setup->x[2]*in_z + setup->x[3];
+		float y2 = setup->y[0]*in_x + setup->y[1]*in_y + setup->y[2]*in_z + setup->y[3];
+		float z2 = setup->z[0]*in_x + setup->z[1]*in_y + setup->z[2]*in_z + setup->z[3];
+
+		float inv_w = 1.f / z2;
+
+		*(out_pos++) = camera->half_width + x2 * inv_w;
+		*(out_pos++) = camera->half_height - y2 * inv_w;
+		*(out_pos++) = z2;
+		*(out_pos++) = inv_w;
+	}
+}
+
+void vertex_shade_float(const object_setup_t *setup, const vertex_camera_t *camera, const model_t *model, float *out_colors) {
+	const float *in_norms = model->norms;
+	for (uint16_t i = 0; i < model->norms_len; i += 3) {
+		float brightness = (
+			  setup->light_x * in_norms[i]
+			+ setup->light_y * in_norms[i+1]
+			+ setup->light_z * in_norms[i+2]
+		);
+		if (brightness < 0.0f) {
+			brightness = 0.0f;
+		}
+
+		out_colors[i] = camera->ambient_r + brightness * camera->directional_r;
+		out_colors[i+1] = camera->ambient_g + brightness * camera->directional_g;
+		out_colors[i+2] = camera->ambient_b + brightness * camera->directional_b;
+	}
+}
+
+void vertex_project_fixed(const object_setup_t *setup, const vertex_camera_t *camera, const model_t *model, float *out_positions) {
+	// Only the per draw state is converted here, the positions were converted up front.
+	fixed_t row_x[4];
+	fixed_t row_y[4];
+	fixed_t row_z[4];
+	row_to_fixed(row_x, setup->x);
+	row_to_fixed(row_y, setup->y);
+	row_to_fixed(row_z, setup->z);
+	fixed_t half_width = float_to_fixed(camera->half_width);
+	fixed_t half_height = float_to_fixed(camera->half_height);
+
+	const fixed_t *in_positions = model->fixed_positions;
+	float *out_pos = out_positions;
+	for (uint16_t i = 0; i < model->positions_len; i += 3) {
+		fixed_t in_x = in_positions[i];
+		fixed_t in_y = in_positions[i + 1];
+		fixed_t in_z = in_positions[i + 2];
+
+		fixed_t x2 = fixed_dot4(row_x, in_x, in_y, in_z);
+		fixed_t y2 = fixed_dot4(row_y, in_x, in_y, in_z);
+		fixed_t z2 = fixed_dot4(row_z, in_x, in_y, in_z);
+
+		if (z2 < MIN_FIXED_DEPTH) z2 = MIN_FIXED_DEPTH;
+		fixed_t inv_w = fixed_reciprocal(z2);
+
+		// rdpq_triangle takes floats, so the results are converted on the way out.
+		*(out_pos++) = fixed_to_float(half_width + fixed_mul(x2, inv_w));
+		*(out_pos++) = fixed_to_float(half_height - fixed_mul(y2, inv_w));
+		*(out_pos++) = fixed_to_float(z2);
+		*(out_pos++) = fixed_to_float(inv_w);
+	}
+}
+
+void vertex_shade_fixed(const object_setup_t *setup, const vertex_camera_t *camera, const model_t *model, float *out_colors) {
+	fixed_t light[4] = {
+		float_to_fixed(setup->light_x),
+		float_to_fixed(setup->light_y),
+		float_to_fixed(setup->light_z),
+		0,
+	};
+	fixed_t ambient[3] = {
+		float_to_fixed(camera->ambient_r),
+		float_to_fixed(camera->ambient_g),
+		float_to_fixed(camera->ambient_b),
+	};
+	fixed_t directional[3] = {
+		float_to_fixed(camera->directional_r),
+		float_to_fixed(camera->directional_g),
+		float_to_fixed(camera->directional_b),
+	};
+
+	const fixed_t *in_norms = model->fixed_norms;
+	for (uint16_t i = 0; i < model->norms_len; i += 3) {
+		fixed_t brightness = fixed_dot4(light, in_norms[i], in_norms[i+1], in_norms[i+2]);
+		if (brightness < 0) {
+			brightness = 0;
+		}
+
+		out_colors[i] = fixed_to_float(ambient[0] + fixed_mul(brightness, directional[0]));
+		out_colors[i+1] = fixed_to_float(ambient[1] + fixed_mul(brightness, directional[1]));
+		out_colors[i+2] = fixed_to_float(ambient[2] + fixed_mul(brightness, directional[2]));
+	}
+}
+
+void model_update_fixed(model_t *model) {
+	if (model->fixed_positions == NULL) {
+		model->fixed_positions = malloc(model->positions_len*sizeof(fixed_t));
+	}
+	if (model->fixed_norms == NULL) {
+		model->fixed_norms = malloc(model->norms_len*sizeof(fixed_t));
+	}
+
+	for (uint16_t i = 0; i < model->positions_len; i++) {
+		model->fixed_positions[i] = float_to_fixed(model->positions[i]);
+	}
+	for (uint16_t i = 0; i < model->norms_len; i++) {
+		model->fixed_norms[i] = float_to_fixed(model->norms[i]);
+	}
+}
+
+// The two frames around progress and how far it is from the first to the second, 0 to 1.
+static float animation_frames(const model_animation_t *animation, float progress, int *frame_a, int *frame_b) {
+	float frame = progress * animation->frame_count;
+	int a = (int)frame;
+	float t = frame - a;
+	a %= animation->frame_count;
+	int b = a + 1;
+	if (b == animation->frame_count) b = 0;
+
+	*frame_a = a;
+	*frame_b = b;
+	return t;
+}
+
+void model_animation_decode(const model_animation_t *animation, float progress) {
+	int frame_a;
+	int frame_b;
+	float t = animation_frames(animation, progress, &frame_a, &frame_b);
+
+	model_t *model = animation->model;
+
+	const int8_t *offsets_a = animation->frame_offsets + frame_a*model->positions_len;
+	const int8_t *offsets_b = animation->frame_offsets + frame_b*model->positions_len;
+	float scale_a = (1.f - t) * animation->offset_scale;
+	float scale_b = t * animation->offset_scale;
+	for (uint16_t i = 0; i < model->positions_len; i++) {
+		model->positions[i] = animation->base_positions[i] + scale_a*offsets_a[i] + scale_b*offsets_b[i];
+	}
+
+	// Blended normals come out slightly short, which is close enough for the shading.
+	const int8_t *norms_a = animation->frame_norms + frame_a*model->norms_len;
+	const int8_t *norms_b = animation->frame_norms + frame_b*model->norms_len;
+	scale_a = (1.f - t) * (1.f / 127.f);
+	scale_b = t * (1.f / 127.f);
+	for (uint16_t i = 0; i < model->norms_len; i++) {
+		model->norms[i] = scale_a*norms_a[i] + scale_b*norms_b[i];
+	}
+}
+
+void model_animation_decode_fixed(const model_animation_t *animation, float progress) {
+	int frame_a;
+	int frame_b;
+	fixed_t t = float_to_fixed(animation_frames(animation, progress, &frame_a, &frame_b));
+
+	model_t *model = animation->model;
+
+	// The offsets blend to 127 << 16 at most, the scale is 8.24 so small scales keep their precision.
+	const int8_t *offsets_a = animation->frame_offsets + frame_a*model->positions_len;
+	const int8_t *offsets_b = animation->frame_offsets + frame_b*model->positions_len;
+	int32_t scale = (int32_t)(animation->offset_scale * (1 << 24));
+	for (uint16_t i = 0; i < model->positions_len; i++) {
+		int32_t offset = offsets_a[i]*(FIXED_ONE - t) + offsets_b[i]*t;
+		model->fixed_positions[i] = animation->fixed_base_positions[i] + (fixed_t)(((int64_t)offset * scale) >> 24);
+	}
+
+	const int8_t *norms_a = animation->frame_norms + frame_a*model->norms_len;
+	const int8_t *norms_b = animation->frame_norms + frame_b*model->norms_len;
+	for (uint16_t i = 0; i < model->norms_len; i++) {
+		model->fixed_norms[i] = (norms_a[i]*(FIXED_ONE - t) + norms_b[i]*t) / 127;
+	}
+}
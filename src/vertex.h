@@ -0,0 +1,83 @@
+#ifndef SPOOK64_VERTEX
+#define SPOOK64_VERTEX
+
+#include "render.h"
+
+// Set to 1 to use the fixed point vertex pipeline instead of float.
+#ifndef RENDER_FIXED_POINT
+#define RENDER_FIXED_POINT 0
+#endif
+
+// The per-vertex part of model rendering, everything before rdpq_triangle.
+// It doesn't touch rdpq so the host can test it, see host/test/vertex_test.c.
+// This all runs on the VR4300. There's no RSP overlay for it yet, one would be
+// checked against the reference in the test.
+
+// Camera, screen and light parameters shared by every draw.
+typedef struct {
+	// Camera rotation and perspective, see set_camera_pitch.
+	float xx;
+	float yy;
+	float yz;
+	float zy;
+	float zz;
+
+	// Perspective scale and the middle of the framebuffer, see update_framebuffer_size.
+	float wx_factor;
+	float wy_factor;
+	float half_width;
+	float half_height;
+
+	// World space light direction and colors.
+	vector3_t light_direction;
+	float directional_r;
+	float directional_g;
+	float directional_b;
+	float ambient_r;
+	float ambient_g;
+	float ambient_b;
+} vertex_camera_t;
+
+// Per-object transform state, set up once per draw.
+// The rotation, translation, camera and screen scale are folded into
+// one 3x4 matrix so each vertex is a single matrix multiply and divide.
+typedef struct {
+	float x[4];
+	float y[4];
+	float z[4];
+
+	// Light direction rotated into model space.
+	float light_x;
+	float light_y;
+	float light_z;
+} object_setup_t;
+
+// s15.16 fixed point, the format of model_t's fixed_positions and fixed_norms.
+typedef int32_t fixed_t;
+
+#define FIXED_SHIFT 16
+#define FIXED_ONE (1 << FIXED_SHIFT)
+
+// relative_position is the object's position minus the camera's.
+void vertex_setup_object(object_setup_t *setup, const vertex_camera_t *camera, const vector3_t *relative_position, float sin_yaw, float cos_yaw);
+
+// Writes x, y, z, 1/w for every position.
+void vertex_project_float(const object_setup_t *setup, const vertex_camera_t *camera, const model_t *model, float *out_positions);
+// Writes r, g, b for every normal.
+void vertex_shade_float(const object_setup_t *setup, const vertex_camera_t *camera, const model_t *model, float *out_colors);
+
+// The same stages in fixed point, reading the model's fixed_positions and fixed_norms.
+// The per vertex math is all integer, the outputs are still float for rdpq_triangle.
+void vertex_project_fixed(const object_setup_t *setup, const vertex_camera_t *camera, const model_t *model, float *out_positions);
+void vertex_shade_fixed(const object_setup_t *setup, const vertex_camera_t *camera, const model_t *model, float *out_colors);
+
+// Converts the model's positions and norms into its fixed point arrays, allocating them if NULL.
+// Call it again whenever the float arrays change.
+void model_update_fixed(model_t *model);
+
+// Blends the two frames around progress into the animation's model, progress wraps around at 1.
+void model_animation_decode(const model_animation_t *animation, float progress);
+// Same, but decodes into the model's fixed point arrays.
+void model_animation_decode_fixed(const model_animation_t *animation, float progress);
+
+#endif
@@ -1,6 +1,18 @@
 from pathlib import Path
+import math
 import os
 
+# Must match STRIP_RESTART in render.h
+STRIP_RESTART = 0xffff
+
+# Must match FIXED_SHIFT in vertex.h
+FIXED_SHIFT = 16
+
+# Entries in the vertex cache the ACMR is measured against.
+# The renderer has no such cache, it projects every vertex once per draw,
+# so ACMR is only reported for comparison and nothing here optimizes for it.
+VERTEX_CACHE_SIZE = 16
+
 def remove_unnecessary(values, used):
     indices = {}
     filtered_values = []
@@ -65,7 +77,7 @@ def minimize_model(positions, uvs, normals, faces):
     return positions, uvs, normals, faces
 
 
-def load_objects_raw(file, is_snooper):
+def parse_obj(file):
     positions = []
     uvs = []
     normals = []
@@ -106,7 +118,50 @@ def load_objects_raw(file, is_snooper):
                 face.append((a, b, c))
             faces.append(tuple(face))
 
-    positions, uvs, normals, faces = minimize_model(positions, uvs, normals, faces)
+    return positions, uvs, normals, faces
+
+
+def stack_frames(frames):
+    # Every position and normal becomes a tuple with one value per frame.
+    # Blender exports each frame with the same positions, uvs and faces
+    # but dedupes the normals differently, so normals are matched up
+    # by face corner instead.
+    positions0, uvs, _, faces0 = frames[0]
+    shape = [[(a, b) for (a, b, c) in face] for face in faces0]
+    for positions, frame_uvs, _, faces in frames[1:]:
+        assert len(positions) == len(positions0), 'animation frames must have the same positions.'
+        assert frame_uvs == uvs, 'animation frames must have the same uvs.'
+        assert [[(a, b) for (a, b, c) in face] for face in faces] == shape, 'animation frames must have the same faces.'
+
+    positions = [tuple(frame[0][i] for frame in frames) for i in range(len(positions0))]
+
+    slots = {}
+    stacked_faces = []
+    for face_index, face in enumerate(faces0):
+        stacked_face = []
+        for corner_index, (a, b, c) in enumerate(face):
+            key = tuple(frame[3][face_index][corner_index][2] for frame in frames)
+            if key not in slots:
+                slots[key] = len(slots)
+            stacked_face.append((a, b, slots[key]))
+        stacked_faces.append(tuple(stacked_face))
+
+    normals = [
+        tuple(frame[2][key[i]] for i, frame in enumerate(frames))
+        for key in slots
+    ]
+    if len(frames) > 1:
+        # Animated normals are stored as int8, snap them now so that
+        # normals which only differ by float noise get merged.
+        normals = [
+            tuple(tuple(round(127.0 * x) / 127.0 for x in norm) for norm in norm_frames)
+            for norm_frames in normals
+        ]
+    return positions, uvs, normals, stacked_faces
+
+
+def load_objects_raw(frames, is_snooper):
+    positions, uvs, normals, faces = minimize_model(*stack_frames(frames))
 
     if not is_snooper:
         yield positions, uvs, normals, faces
@@ -115,7 +170,7 @@ def load_objects_raw(file, is_snooper):
     # uhhh for whatever reason the snooper is too big
     # idk how to use blender
     # just scale the positions
-    positions = [tuple(0.6*x for x in pos) for pos in positions]
+    positions = [tuple(tuple(0.6*x for x in pos) for pos in frame_pos) for frame_pos in positions]
 
     feet = set()
     head = set()
@@ -140,77 +195,465 @@ def sub_model(pos_indices, positions, uvs, normals, faces):
     return minimize_model(positions, uvs, normals, faces)
 
     
-def load_objects(file, is_snooper):
-    for positions, uvs, normals, faces in load_objects_raw(file, is_snooper):
-        faces = [
-            tuple(
-                x
-                for (pos_idx, uv_idx, norm_idx) in face
-                for x in [
-                    # convert indices to offsets.
-                    3*pos_idx,
-                    2*uv_idx,
-                    3*norm_idx,
-                ]
-            )
-            for face in faces
+# Grid cell size for each level of detail, relative to the model's bounding diameter.
+LOD_CELL_SIZES = [1.0 / 4.0, 1.0 / 2.0]
+# Models smaller than this aren't worth decimating.
+LOD_MIN_POSITIONS = 16
+
+
+def cluster_faces(positions, faces, cell_size):
+    # Vertex clustering on the first frame. Every position in a grid cell
+    # collapses onto the one closest to the cell's mean, so the result only
+    # uses existing positions and still follows the animation.
+    used = sorted(set(a for face in faces for (a, b, c) in face))
+    cells = {}
+    for i in used:
+        cell = tuple(int(x // cell_size) for x in positions[i][0])
+        cells.setdefault(cell, []).append(i)
+
+    representatives = {}
+    for members in cells.values():
+        mean = tuple(sum(positions[i][0][j] for i in members) / len(members) for j in range(3))
+        best = min(members, key=lambda i: sum((positions[i][0][j] - mean[j]) ** 2 for j in range(3)))
+        for i in members:
+            representatives[i] = best
+
+    clustered = []
+    seen = set()
+    for face in faces:
+        face = tuple((representatives[a], b, c) for (a, b, c) in face)
+        if len(set(a for (a, b, c) in face)) < 3:
+            continue
+        if face in seen:
+            continue
+        seen.add(face)
+        clustered.append(face)
+    return clustered
+
+
+def make_lods(positions, faces):
+    if len(positions) < LOD_MIN_POSITIONS:
+        return []
+
+    all_positions = [frame_pos for pos in positions for frame_pos in pos]
+    _, radius = bounding_sphere(all_positions)
+
+    # Each level is clustered from the one before it, so it only uses a
+    # subset of its positions and normals.
+    lods = []
+    lod_faces = faces
+    for cell_size in LOD_CELL_SIZES:
+        clustered = cluster_faces(positions, lod_faces, 2.0 * radius * cell_size)
+        if not clustered or len(clustered) >= len(lod_faces):
+            continue
+        lod_faces = clustered
+        lods.append(lod_faces)
+    return lods
+
+
+def order_by_lod(positions, normals, faces, lods):
+    # Moves the values used by the coarsest level to the front, then the next
+    # level and so on, so every level draws from a prefix of the arrays.
+    def ordering(count, index):
+        order = []
+        placed = set()
+        for level_faces in reversed(lods):
+            for face in level_faces:
+                for corner in face:
+                    i = corner[index]
+                    if i not in placed:
+                        placed.add(i)
+                        order.append(i)
+        order += [i for i in range(count) if i not in placed]
+        return order, {old: new for new, old in enumerate(order)}
+
+    position_order, position_map = ordering(len(positions), 0)
+    normal_order, normal_map = ordering(len(normals), 2)
+
+    def remap(level_faces):
+        return [
+            tuple((position_map[a], b, normal_map[c]) for (a, b, c) in face)
+            for face in level_faces
         ]
-        yield positions, uvs, normals, faces
 
+    positions = [positions[i] for i in position_order]
+    normals = [normals[i] for i in normal_order]
+    return positions, normals, remap(faces), [remap(level_faces) for level_faces in lods]
+
+
+def load_objects(frames, is_snooper):
+    for positions, uvs, normals, faces in load_objects_raw(frames, is_snooper):
+        lods = make_lods(positions, faces)
+        positions, normals, faces, lods = order_by_lod(positions, normals, faces, lods)
+
+        # Each unique (position, uv, normal) tuple becomes one vertex
+        # so the renderer only has to set it up once.
+        verts, tris = index_vertices(faces)
+        lods = [index_vertices(level_faces) for level_faces in lods]
+        yield positions, uvs, normals, verts, tris, lods
+
+
+def index_vertices(faces):
+    verts = []
+    vert_indices = {}
+    tris = []
+    for face in faces:
+        tri = []
+        for vert in face:
+            if vert not in vert_indices:
+                vert_indices[vert] = len(verts)
+                verts.append(vert)
+            tri.append(vert_indices[vert])
+        tris.append(tuple(tri))
+    return verts, tris
+
+
+def rotations(tri):
+    a, b, c = tri
+    return [(a, b, c), (b, c, a), (c, a, b)]
+
+
+def make_strips(tris):
+    # Strips only make the index data smaller, each vertex is projected once
+    # per draw whatever order the triangles come in.
+    # Greedy stripification. Every other triangle in a strip has its
+    # winding flipped, so the next triangle after [..., p, q] must be
+    # (p, q, r) on even steps and (q, p, r) on odd steps.
+    by_edge = {}
+    for tri_index, tri in enumerate(tris):
+        for a, b, c in rotations(tri):
+            by_edge[(a, b)] = (tri_index, c)
+
+    used = [False] * len(tris)
+
+    def unused_neighbors(tri_index):
+        count = 0
+        for a, b, c in rotations(tris[tri_index]):
+            neighbor = by_edge.get((b, a))
+            if neighbor is not None and not used[neighbor[0]]:
+                count += 1
+        return count
+
+    def extend(start):
+        strip = list(start)
+        taken = []
+        while True:
+            p, q = strip[-2], strip[-1]
+            next_step = len(strip) - 2
+            edge = (p, q) if next_step % 2 == 0 else (q, p)
+            next_tri = by_edge.get(edge)
+            if next_tri is None:
+                break
+            tri_index, r = next_tri
+            if used[tri_index] or tri_index in taken:
+                break
+            taken.append(tri_index)
+            strip.append(r)
+        return strip, taken
+
+    strips = []
+    while not all(used):
+        start_index = min(
+            (i for i in range(len(tris)) if not used[i]),
+            key=unused_neighbors,
+        )
+        used[start_index] = True
+        best_strip, best_taken = None, []
+        for start in rotations(tris[start_index]):
+            strip, taken = extend(start)
+            if best_strip is None or len(taken) > len(best_taken):
+                best_strip, best_taken = strip, taken
+        for tri_index in best_taken:
+            used[tri_index] = True
+        strips.append(best_strip)
+
+    check_strips(tris, strips)
+    return strips
+
+
+def strip_triangles(strip):
+    for i in range(len(strip) - 2):
+        a, b, c = strip[i], strip[i+1], strip[i+2]
+        yield (b, a, c) if i % 2 else (a, b, c)
+
+
+def canonical(tri):
+    return min(rotations(tri))
+
+
+def check_strips(tris, strips):
+    expected = sorted(canonical(tri) for tri in tris)
+    actual = sorted(canonical(tri) for strip in strips for tri in strip_triangles(strip))
+    assert expected == actual, 'strips must cover the same triangles.'
+
+
+def bounding_sphere(positions):
+    # Centered on the bounding box, which is good enough for culling.
+    center = tuple(
+        0.5 * (min(pos[i] for pos in positions) + max(pos[i] for pos in positions))
+        for i in range(3)
+    )
+    radius = max(
+        sum((pos[i] - center[i]) ** 2 for i in range(3)) ** 0.5
+        for pos in positions
+    )
+    return center, radius
+
+
+def split_lines(indices):
+    # One strip per line, each restart ends a line.
+    line = []
+    for i in indices:
+        line.append(i)
+        if i == STRIP_RESTART:
+            yield line
+            line = []
+    if line:
+        yield line
+
+
+def flatten_strips(strips):
+    indices = []
+    for strip in strips:
+        if indices:
+            indices.append(STRIP_RESTART)
+        indices.extend(strip)
+    return indices
+
+
+
+def quantize_animation(positions, normals):
+    # Positions become int8 offsets from the first frame with one shared scale,
+    # normals are unit length so they're stored as int8 directly.
+    frame_count = len(positions[0])
+    base = [pos[0] for pos in positions]
+    offsets = [
+        [pos[frame][i] - pos[0][i] for pos in positions for i in range(3)]
+        for frame in range(frame_count)
+    ]
+    max_offset = max(abs(x) for frame in offsets for x in frame)
+    scale = max_offset / 127.0 if max_offset > 0.0 else 1.0
+
+    def to_int8(x):
+        return max(-127, min(127, round(x)))
+
+    quantized_offsets = [[to_int8(x / scale) for x in frame] for frame in offsets]
+    quantized_normals = [
+        [to_int8(127.0 * norm[frame][i]) for norm in normals for i in range(3)]
+        for frame in range(frame_count)
+    ]
+    max_error = max(
+        abs(q * scale - x)
+        for frame, quantized_frame in zip(offsets, quantized_offsets)
+        for x, q in zip(frame, quantized_frame)
+    )
+    return base, quantized_offsets, scale, quantized_normals, max_error
+
+
+def to_fixed(row):
+    # Rounded like float_to_fixed in vertex.c.
+    return [math.floor(x * (1 << FIXED_SHIFT) + 0.5) for x in row]
+
+
+def write_array(c_file, declaration, rows):
+    c_file.write(
+        declaration + ' = {\n'
+            + '\n'.join('\t' + ', '.join(map(str, row)) + ',' for row in rows)
+            + '\n};\n'
+    )
+
+
+def acmr(tris):
+    # Average cache misses per triangle through a FIFO cache of transformed vertices.
+    cache = []
+    misses = 0
+    for tri in tris:
+        for vert in tri:
+            if vert in cache:
+                continue
+            misses += 1
+            cache.append(vert)
+            if len(cache) > VERTEX_CACHE_SIZE:
+                cache.pop(0)
+    return misses / len(tris)
+
+
+def write_indices(c_file, model_name, verts, tris):
+    # Lone triangles stay in a plain list, the rest become strips.
+    all_strips = make_strips(tris)
+    list_tris = [tuple(strip) for strip in all_strips if len(strip) == 3]
+    strips = flatten_strips([strip for strip in all_strips if len(strip) > 3])
+    strip_tri_count = len(tris) - len(list_tris)
+
+    # The order the renderer draws them in: the list, then each strip.
+    drawn_tris = list_tris + [
+        tri for strip in all_strips if len(strip) > 3 for tri in strip_triangles(strip)
+    ]
+    indices_before = sum(len(tri) for tri in tris)
+    indices_after = sum(len(tri) for tri in list_tris) + len(strips)
+    print(
+        f'{model_name}: {len(tris)} tris, {len(verts)} verts, '
+        + f'{indices_before / len(verts):.2f} average vertex reuse, '
+        + f'{strip_tri_count} tris in strips, '
+        + f'indices {indices_before} -> {indices_after} '
+        + f'({indices_before / len(tris):.2f} -> {indices_after / len(tris):.2f} per tri), '
+        + f'ACMR {acmr(tris):.2f} -> {acmr(drawn_tris):.2f}'
+    )
+
+    write_array(c_file, f'static uint16_t {model_name}_vertices[]', verts)
+    write_array(c_file, f'static uint16_t {model_name}_triangles[]', list_tris)
+    write_array(c_file, f'static uint16_t {model_name}_strips[]', split_lines(strips))
+
+
+def write_model(c_file, h_file, model_name, positions, texcoords, normals, verts, tris, lods):
+    frame_count = len(positions[0])
+
+    h_file.write(f'extern model_t {model_name}_model;\n')
+
+    # The fixed point pipeline reads its own copy, converted here instead of at runtime.
+    if frame_count == 1:
+        write_array(c_file, f'static float {model_name}_positions[]', [pos[0] for pos in positions])
+        write_array(c_file, f'static float {model_name}_normals[]', [norm[0] for norm in normals])
+        write_array(c_file, f'static int32_t {model_name}_fixed_positions[]', [to_fixed(pos[0]) for pos in positions])
+        write_array(c_file, f'static int32_t {model_name}_fixed_normals[]', [to_fixed(norm[0]) for norm in normals])
+    else:
+        base, offsets, scale, frame_normals, max_error = quantize_animation(positions, normals)
+
+        # The decoded frame goes in the model's own position and normal arrays.
+        c_file.write(f'static float {model_name}_positions[{3 * len(positions)}];\n')
+        c_file.write(f'static float {model_name}_normals[{3 * len(normals)}];\n')
+        c_file.write(f'static int32_t {model_name}_fixed_positions[{3 * len(positions)}];\n')
+        c_file.write(f'static int32_t {model_name}_fixed_normals[{3 * len(normals)}];\n')
+        write_array(c_file, f'static const float {model_name}_base_positions[]', base)
+        write_array(c_file, f'static const int32_t {model_name}_fixed_base_positions[]', map(to_fixed, base))
+        write_array(c_file, f'static const int8_t {model_name}_frame_offsets[]', offsets)
+        write_array(c_file, f'static const int8_t {model_name}_frame_normals[]', frame_normals)
+
+        index_bytes = 2 * (3 * len(verts) + 3 * len(tris))
+        full_bytes = frame_count * (4 * 3 * (len(positions) + len(normals)) + index_bytes)
+        packed_bytes = 4 * 3 * len(positions) + frame_count * 3 * (len(positions) + len(normals)) + index_bytes
+        print(
+            f'{model_name}: {frame_count} frames, '
+            + f'{full_bytes} -> {packed_bytes} bytes, '
+            + f'max position error {max_error:.4f}'
+        )
+
+    write_array(c_file, f'static float {model_name}_texcoords[]', texcoords)
+    write_indices(c_file, model_name, verts, tris)
+
+    # Bounds cover every frame so the culling doesn't depend on the animation.
+    # The lods share them, they can only shrink.
+    center, radius = bounding_sphere([frame_pos for pos in positions for frame_pos in pos])
+    bounds = ', '.join(f'{x}f' for x in (*center, radius))
+
+    # Coarsest first so each level can point at the next one down.
+    lod = 'NULL'
+    for level in reversed(range(len(lods))):
+        lod_verts, lod_tris = lods[level]
+        lod_name = f'{model_name}_lod{level + 1}'
+        write_indices(c_file, lod_name, lod_verts, lod_tris)
+        c_file.write(
+            f'static model_t {lod_name}_model = MODEL_LOD(\n'
+            + f'\t{model_name}_positions, {3 * (max(v[0] for v in lod_verts) + 1)},\n'
+            + f'\t{model_name}_texcoords,\n'
+            + f'\t{model_name}_normals, {3 * (max(v[2] for v in lod_verts) + 1)},\n'
+            + f'\t{lod_name}_vertices,\n'
+            + f'\t{lod_name}_triangles,\n'
+            + f'\t{lod_name}_strips,\n'
+            + f'\t{bounds},\n'
+            + f'\t{lod},\n'
+            + f'\t{model_name}_fixed_positions,\n'
+            + f'\t{model_name}_fixed_normals);\n'
+        )
+        lod = f'&{lod_name}_model'
+
+    c_file.write(
+        f'model_t {model_name}_model = MODEL_BOUNDED(\n'
+        + f'\t{model_name}_positions,\n'
+        + f'\t{model_name}_texcoords,\n'
+        + f'\t{model_name}_normals,\n'
+        + f'\t{model_name}_vertices,\n'
+        + f'\t{model_name}_triangles,\n'
+        + f'\t{model_name}_strips,\n'
+        + f'\t{bounds},\n'
+        + f'\t{lod},\n'
+        + f'\t{model_name}_fixed_positions,\n'
+        + f'\t{model_name}_fixed_normals);\n'
+    )
+
+    if frame_count == 1:
+        return False
+
+    h_file.write(f'extern model_animation_t {model_name}_animation;\n')
+    c_file.write(
+        f'model_animation_t {model_name}_animation = MODEL_ANIMATION(\n'
+        + f'\t{model_name}_model,\n'
+        + f'\t{model_name}_base_positions,\n'
+        + f'\t{model_name}_fixed_base_positions,\n'
+        + f'\t{model_name}_frame_offsets,\n'
+        + f'\t{scale}f,\n'
+        + f'\t{model_name}_frame_normals);\n'
+    )
+    return True
 
 
 def main():
     root_dir = Path(__file__).parent.parent
     blender_dir = root_dir / 'blender'
 
+    # Numbered exports (name_000001.obj, ...) are frames of one animation.
+    groups = {}
+    for filename in sorted(os.listdir(blender_dir)):
+        if not filename.endswith('.obj'):
+            continue
+        group_name = filename.split('.')[0].split('_')[0]
+        groups.setdefault(group_name, []).append(filename)
+
     with open(root_dir / 'src' / '_generated_models.c', 'w') as c_file:
         with open(root_dir / 'src' / '_generated_models.h', 'w') as h_file:
             c_file.write('#include "render.h"\n')
+            c_file.write('#include "_generated_models.h"\n')
+            h_file.write('#ifndef SPOOK64_GENERATED_MODELS\n#define SPOOK64_GENERATED_MODELS\n')
+
+            # (name, animated) for the table of every model at the end.
+            written = []
+            for group_name, filenames in groups.items():
+                frames = []
+                for filename in filenames:
+                    with open(blender_dir / filename) as file:
+                        frames.append(parse_obj(file))
 
-            for filename in os.listdir(blender_dir):
-                if not filename.endswith('.obj'):
-                    continue
                 # I didn't split the feet of the snooper in blender
                 # so I'm splitting it here instead.
-                is_snooper = filename.startswith('snooper')
-                with open(blender_dir / filename) as file:
-                    for (positions, texcoords, normals, tris) in load_objects(file, is_snooper):
-                        model_name = filename.split('.')[0]
-                        if is_snooper and len(positions) <= 8:
-                            model_name += '_feet'
-                        float_arrays = [
-                            (positions, 'positions'),
-                            (texcoords, 'texcoords'),
-                            (normals, 'normals'),
-                        ]
-                        h_file.write(
-                            f'extern model_t {model_name}_model;\n'
-                        )
-                        for array, array_name in float_arrays:
-                            c_file.write(
-                                f'static float {model_name}_{array_name}[] = ' + '{\n'
-                                    + '\n'.join(
-                                        '\t' + ', '.join(map(str, x)) + ','
-                                        for x in array
-                                    )
-                                    + '\n};\n'
-                            )
-                        c_file.write(
-                            f'static uint16_t {model_name}_triangles[] = ' + '{\n'
-                                + '\n'.join(
-                                    '\t' + ', '.join(str(i) for i in tri) + ','
-                                    for tri in tris
-                                )
-                                + '\n};\n'
-                        )
-                        c_file.write(
-                            f'model_t {model_name}_model = MODEL(\n'
-                            + f'\t{model_name}_positions,\n'
-                            + f'\t{model_name}_texcoords,\n'
-                            + f'\t{model_name}_normals,\n'
-                            + f'\t{model_name}_triangles);\n'
-                        )
-                    
+                is_snooper = group_name == 'snooper'
+                for (positions, texcoords, normals, verts, tris, lods) in load_objects(frames, is_snooper):
+                    model_name = group_name
+                    if is_snooper and len(positions) <= 8:
+                        model_name += '_feet'
+                    animated = write_model(c_file, h_file, model_name, positions, texcoords, normals, verts, tris, lods)
+                    written.append((model_name, animated))
+
+            h_file.write(
+                '\n// Every model above, for tools that go over all of them.\n'
+                + 'typedef struct {\n'
+                + '\tconst char *name;\n'
+                + '\tmodel_t *model;\n'
+                + '\t// NULL for models without animation.\n'
+                + '\tmodel_animation_t *animation;\n'
+                + '} generated_model_t;\n\n'
+                + f'#define GENERATED_MODEL_COUNT {len(written)}\n'
+                + 'extern const generated_model_t generated_models[GENERATED_MODEL_COUNT];\n'
+                + '#endif\n'
+            )
+            c_file.write(
+                'const generated_model_t generated_models[GENERATED_MODEL_COUNT] = {\n'
+                + ''.join(
+                    f'\t{{"{name}", &{name}_model, {f"&{name}_animation" if animated else "NULL"}}},\n'
+                    for name, animated in written
+                )
+                + '};\n'
+            )
+
 
 if __name__ == '__main__':
 	main()
@@ -0,0 +1,85 @@
+import argparse
+import json
+import sys
+
+# Converts a trace_dump() from the debug log into Chrome trace JSON,
+# which can be opened in chrome://tracing or ui.perfetto.dev.
+#
+#   python tools/trace2json.py isviewer.log -o trace.json
+#
+# The log can contain anything else as well, the last complete dump is used.
+
+
+def parse_dumps(lines):
+    dumps = []
+    current = None
+    for line in lines:
+        parts = line.split()
+        if not parts:
+            continue
+        if parts[0] == 'trace' and len(parts) >= 2 and parts[1] == 'begin':
+            ticks_per_second = int(parts[2])
+            current = (ticks_per_second, [])
+        elif parts[0] == 'trace' and len(parts) >= 2 and parts[1] == 'end':
+            if current is not None:
+                dumps.append(current)
+            current = None
+        elif parts[0] == 't' and current is not None:
+            assert len(parts) == 5, f'bad trace event: {line.strip()}'
+            name, start, duration, frame = parts[1], int(parts[2]), int(parts[3]), int(parts[4])
+            current[1].append((name, start, duration, frame))
+    return dumps
+
+
+def to_chrome_trace(ticks_per_second, events):
+    ticks_per_us = ticks_per_second / 1000000.0
+    trace_events = [
+        {'name': 'process_name', 'ph': 'M', 'pid': 0, 'args': {'name': 'spook64'}},
+        {'name': 'thread_name', 'ph': 'M', 'pid': 0, 'tid': 0, 'args': {'name': 'cpu'}},
+    ]
+    for name, start, duration, frame in events:
+        event = {
+            'name': name,
+            'pid': 0,
+            'tid': 0,
+            'ts': start / ticks_per_us,
+            'args': {'frame': frame},
+        }
+        if name == 'frame':
+            event['ph'] = 'i'
+            event['s'] = 'g'
+        else:
+            event['ph'] = 'X'
+            event['dur'] = duration / ticks_per_us
+        trace_events.append(event)
+
+    # Viewers want parents before children when they start at the same time.
+    trace_events.sort(key=lambda e: (e.get('ts', -1.0), -e.get('dur', 0.0)))
+    return {'traceEvents': trace_events, 'displayTimeUnit': 'ms'}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert a spook64 trace dump to Chrome trace JSON.')
+    parser.add_argument('log', nargs='?', help='debug log containing a trace dump, defaults to stdin')
+    parser.add_argument('-o', '--output', help='output file, defaults to stdout')
+    args = parser.parse_args()
+
+    if args.log:
+        with open(args.log) as file:
+            dumps = parse_dumps(file)
+    else:
+        dumps = parse_dumps(sys.stdin)
+
+    if not dumps:
+        sys.exit('no complete trace dump found.')
+
+    trace = to_chrome_trace(*dumps[-1])
+    if args.output:
+        with open(args.output, 'w') as file:
+            json.dump(trace, file)
+    else:
+        json.dump(trace, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()